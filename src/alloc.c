@@ -0,0 +1,319 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+/* Shared allocator for the benchmark arrays. NRMB_PAGES selects the pages
+ * backing them:
+ * - malloc (default): the C library.
+ * - 4k: anonymous mapping with transparent huge pages disabled.
+ * - thp: anonymous mapping aligned on huge pages, advised to use them.
+ * - 2m, 1g: explicit huge pages from hugetlbfs, falling back to thp when the
+ *   system has none reserved.
+ * NRMB_ALIGN aligns any of them, mappings on the larger of it and their page.
+ * Mappings are placed according to NRMB_NUMA before anything touches them.
+ * Placement needs a mapping of our own, so malloc then becomes a plain
+ * page-aligned mapping, which leaves transparent huge pages to the system
+ * default as malloc would.
+ */
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define NRMB_THP_SIZE (2UL << 20)
+#define NRMB_MAX_MAPPINGS 64
+
+enum nrmb_pages {
+	NRMB_PAGES_MALLOC,
+	NRMB_PAGES_MMAP,
+	NRMB_PAGES_4K,
+	NRMB_PAGES_THP,
+	NRMB_PAGES_2M,
+	NRMB_PAGES_1G,
+};
+
+static int alloc_initialized;
+static enum nrmb_pages alloc_pages = NRMB_PAGES_MALLOC;
+static const char *alloc_spec = "malloc";
+static size_t alloc_align;
+static int alloc_fallback;
+
+/* mappings need their length to be released */
+static struct {
+	void *ptr;
+	size_t size;
+} alloc_mappings[NRMB_MAX_MAPPINGS];
+
+static void nrmb_alloc_setup(void)
+{
+	const char *spec = getenv("NRMB_PAGES");
+	const char *align = getenv("NRMB_ALIGN");
+
+	if (alloc_initialized)
+		return;
+	alloc_initialized = 1;
+
+	if (spec != NULL && *spec != '\0') {
+		if (!strcmp(spec, "malloc"))
+			alloc_pages = NRMB_PAGES_MALLOC;
+		else if (!strcmp(spec, "4k"))
+			alloc_pages = NRMB_PAGES_4K;
+		else if (!strcmp(spec, "thp"))
+			alloc_pages = NRMB_PAGES_THP;
+		else if (!strcmp(spec, "2m"))
+			alloc_pages = NRMB_PAGES_2M;
+		else if (!strcmp(spec, "1g"))
+			alloc_pages = NRMB_PAGES_1G;
+		else
+			assert(0 && "unknown NRMB_PAGES backend");
+		alloc_spec = spec;
+	}
+
+	if (align != NULL && *align != '\0') {
+		if (!strcmp(align, "cacheline")) {
+			long line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+			alloc_align = line > 0 ? (size_t)line : 64;
+		}
+		else if (!strcmp(align, "page"))
+			alloc_align = sysconf(_SC_PAGESIZE);
+		else {
+			errno = 0;
+			alloc_align = strtoull(align, NULL, 0);
+			assert(!errno);
+		}
+		/* posix_memalign wants a power of two multiple of a pointer */
+		assert(alloc_align >= sizeof(void *));
+		assert((alloc_align & (alloc_align - 1)) == 0);
+	}
+
+	/* mbind needs page-aligned ranges that belong to us only */
+	if (alloc_pages == NRMB_PAGES_MALLOC && nrmb_numa_placed()) {
+		alloc_pages = NRMB_PAGES_MMAP;
+		alloc_spec = "mmap";
+	}
+}
+
+const char *nrmb_alloc_spec(void)
+{
+	nrmb_alloc_setup();
+	return alloc_spec;
+}
+
+/* anonymous mapping of size bytes aligned on align, trimmed from a larger
+ * mapping when align is more than a page. Both size and align must be
+ * multiples of the page size that flags ask for.
+ */
+static void *nrmb_map_aligned(size_t size, size_t align, int flags)
+{
+	size_t length = size + align;
+	char *p, *ret;
+
+	p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	ret = (char *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+	if (ret != p)
+		munmap(p, ret - p);
+	if (p + length != ret + size)
+		munmap(ret + size, (p + length) - (ret + size));
+	return ret;
+}
+
+static void *nrmb_map(size_t *size)
+{
+	void *p = NULL;
+	size_t page;
+	int flags;
+
+	switch (alloc_pages) {
+	case NRMB_PAGES_2M:
+	case NRMB_PAGES_1G:
+		if (alloc_pages == NRMB_PAGES_2M) {
+			page = 2UL << 20;
+			flags = MAP_HUGE_2MB;
+		}
+		else {
+			page = 1UL << 30;
+			flags = MAP_HUGE_1GB;
+		}
+		*size = (*size + page - 1) & ~(page - 1);
+		/* huge pages come aligned, over-allocating to align on
+		 * them would take one more from the reserve.
+		 */
+		if (alloc_align > page)
+			p = nrmb_map_aligned(*size, alloc_align,
+					     MAP_HUGETLB | flags);
+		else
+			p = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+				 flags, -1, 0);
+		if (p != MAP_FAILED && p != NULL)
+			return p;
+		if (!alloc_fallback)
+			fprintf(stderr, "nrmb: no %s huge pages available, using thp\n",
+				alloc_spec);
+		alloc_fallback = 1;
+		/* fall through */
+	case NRMB_PAGES_THP:
+		*size = (*size + NRMB_THP_SIZE - 1) & ~(NRMB_THP_SIZE - 1);
+		p = nrmb_map_aligned(*size, NRMB_MAX(alloc_align,
+						     NRMB_THP_SIZE), 0);
+		if (p != NULL)
+			madvise(p, *size, MADV_HUGEPAGE);
+		return p;
+	case NRMB_PAGES_MMAP:
+		page = sysconf(_SC_PAGESIZE);
+		*size = (*size + page - 1) & ~(page - 1);
+		return nrmb_map_aligned(*size, NRMB_MAX(alloc_align, page), 0);
+	case NRMB_PAGES_4K:
+	default:
+		page = sysconf(_SC_PAGESIZE);
+		*size = (*size + page - 1) & ~(page - 1);
+		p = nrmb_map_aligned(*size, NRMB_MAX(alloc_align, page), 0);
+		if (p != NULL)
+			madvise(p, *size, MADV_NOHUGEPAGE);
+		return p;
+	}
+}
+
+void *nrmb_alloc(size_t size)
+{
+	void *ret = NULL;
+	int i;
+
+	nrmb_alloc_setup();
+	if (alloc_pages == NRMB_PAGES_MALLOC) {
+		if (alloc_align == 0)
+			ret = malloc(size);
+		else if (posix_memalign(&ret, alloc_align, size) != 0)
+			ret = NULL;
+		assert(ret != NULL);
+		return ret;
+	}
+
+	for (i = 0; i < NRMB_MAX_MAPPINGS; i++)
+		if (alloc_mappings[i].ptr == NULL)
+			break;
+	assert(i < NRMB_MAX_MAPPINGS);
+
+	ret = nrmb_map(&size);
+	assert(ret != NULL);
+	nrmb_numa_place(ret, size);
+	alloc_mappings[i].ptr = ret;
+	alloc_mappings[i].size = size;
+	return ret;
+}
+
+void *nrmb_calloc(size_t n, size_t size)
+{
+	void *ret;
+
+	nrmb_alloc_setup();
+	/* fresh mappings are already zeroed, and calloc can avoid touching
+	 * memory that the kernel hands out zeroed.
+	 */
+	if (alloc_pages == NRMB_PAGES_MALLOC && alloc_align == 0) {
+		ret = calloc(n, size);
+		assert(ret != NULL);
+		return ret;
+	}
+	ret = nrmb_alloc(n * size);
+	if (alloc_pages == NRMB_PAGES_MALLOC)
+		memset(ret, 0, n * size);
+	return ret;
+}
+
+void nrmb_free(void *p)
+{
+	if (p == NULL)
+		return;
+	for (int i = 0; i < NRMB_MAX_MAPPINGS; i++) {
+		if (alloc_mappings[i].ptr == p) {
+			munmap(p, alloc_mappings[i].size);
+			alloc_mappings[i].ptr = NULL;
+			return;
+		}
+	}
+	free(p);
+}
+
+size_t nrmb_page_size(const void *p, double *huge)
+{
+	FILE *smaps = fopen("/proc/self/smaps", "r");
+	char line[256];
+	uintptr_t addr = (uintptr_t)p, start, end;
+	size_t kernel_page = 0, rss = 0, anon_huge = 0, value;
+	int found = 0;
+
+	*huge = 0.0;
+	if (smaps == NULL)
+		return 0;
+
+	/* the mapping header is followed by its "Field: value kB" lines */
+	while (fgets(line, sizeof(line), smaps) != NULL) {
+		if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &start, &end) == 2) {
+			if (found)
+				break;
+			found = start <= addr && addr < end;
+			continue;
+		}
+		if (!found)
+			continue;
+		if (sscanf(line, "KernelPageSize: %zu kB", &value) == 1)
+			kernel_page = value * 1024;
+		else if (sscanf(line, "Rss: %zu kB", &value) == 1)
+			rss = value * 1024;
+		else if (sscanf(line, "AnonHugePages: %zu kB", &value) == 1)
+			anon_huge = value * 1024;
+	}
+	fclose(smaps);
+
+	if (!found)
+		return 0;
+	/* hugetlb mappings report their page size directly, transparent huge
+	 * pages only show up as a part of the resident memory.
+	 */
+	if (kernel_page > (size_t)sysconf(_SC_PAGESIZE)) {
+		*huge = 1.0;
+		return kernel_page;
+	}
+	if (anon_huge > 0 && rss > 0) {
+		*huge = (double)anon_huge / rss;
+		return NRMB_THP_SIZE;
+	}
+	return kernel_page;
+}
+
+void nrmb_alloc_report(FILE *out, struct nrmb_report *r, const char *name,
+		       const void *p)
+{
+	double huge;
+	size_t page = nrmb_page_size(p, &huge);
+	char key[64];
+
+	fprintf(out, "Pages %s: requested %s, obtained %zu KiB (%.1f%% huge)\n",
+		name, nrmb_alloc_spec(), page / 1024, 100.0 * huge);
+	snprintf(key, sizeof(key), "%s_page_size", name);
+	nrmb_report_metric(r, key, page);
+	snprintf(key, sizeof(key), "%s_huge_fraction", name);
+	nrmb_report_metric(r, key, huge);
+}
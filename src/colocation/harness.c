@@ -0,0 +1,305 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "progress/phases/mixed.h"
+#include "sinks.h"
+
+/* Co-location harness: forks instances of a kernel, each pinned to its own
+ * share of the CPUs the harness may run on. The instances first run their
+ * timed loop alone, one after the other, then all together, going through a
+ * process-shared barrier before each of these runs. In the co-located run,
+ * instances that are done keep running the kernel, untimed, until the last one
+ * is done, so that every timed step sees the same interference.
+ *
+ * The parent never enters an OpenMP region, so that each instance starts
+ * with a fresh OpenMP runtime after the fork.
+ */
+#define HARNESS_CPUS 256
+
+struct instance {
+	int num_cpus;
+	int cpus[HARNESS_CPUS];
+	struct nrmb_hist solo;
+	struct nrmb_hist colo;
+	int err;
+};
+
+struct harness {
+	pthread_barrier_t barrier;
+	int done;
+	struct instance instances[];
+};
+
+/* progress of each instance goes to its own file, when the sink or the
+ * shared counters have one, by suffixing the path with the instance number.
+ * The path of the mmap sink is split off its capacity as the sink does it.
+ */
+static void instance_env(int id)
+{
+	const char *shm = getenv("NRMB_PROGRESS_SHM");
+	const char *sink = getenv("NRMB_PROGRESS_SINK");
+	char buf[4096];
+
+	if (shm != NULL && *shm != '\0') {
+		snprintf(buf, sizeof(buf), "%s.%d", shm, id);
+		setenv("NRMB_PROGRESS_SHM", buf, 1);
+	}
+	if (sink != NULL && !strncmp(sink, "file:", 5)) {
+		snprintf(buf, sizeof(buf), "%s.%d", sink, id);
+		setenv("NRMB_PROGRESS_SINK", buf, 1);
+	}
+	if (sink != NULL && !strncmp(sink, "mmap:", 5)) {
+		const char *sep = nrmb_sink_mmap_path_end(sink + 5);
+		snprintf(buf, sizeof(buf), "%.*s.%d%s",
+			 (int)(sep - sink), sink, id, sep);
+		setenv("NRMB_PROGRESS_SINK", buf, 1);
+	}
+}
+
+/* timed loop of one instance, each step recorded in hist */
+static void instance_loop(enum mixed_kernel kernel, const char *length,
+			  struct nrmb_hist *hist, struct nrmb_thread_hist *busy)
+{
+	nrm_time_t start, end;
+	long int times = nrmb_parse_times(length);
+
+	nrmb_hist_init(hist);
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		nrm_time_gettime(&start);
+		mixed_step(kernel, iter, busy);
+		nrm_time_gettime(&end);
+		nrmb_hist_record(hist, nrm_time_diff(&start, &end));
+	}
+}
+
+static int instance_main(struct harness *h, int id, int num_instances,
+			 enum mixed_kernel kernel, const char *length,
+			 const char *progname)
+{
+	struct instance *me = &h->instances[id];
+	struct nrmb_thread_hist busy;
+	char name[256];
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	for (int i = 0; i < me->num_cpus; i++)
+		CPU_SET(me->cpus[i], &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+	omp_set_num_threads(me->num_cpus);
+
+	instance_env(id);
+	nrmb_numa_init();
+	mixed_setup(kernel, me->num_cpus);
+	nrmb_thread_hist_init(&busy, me->num_cpus);
+
+	/* NRM Context init */
+	snprintf(name, sizeof(name), "%s.%d", progname, id);
+	nrmb_init(name);
+	nrmb_send_progress(1.0);
+
+	/* alone, one instance at a time */
+	for (int i = 0; i < num_instances; i++) {
+		pthread_barrier_wait(&h->barrier);
+		if (i == id)
+			instance_loop(kernel, length, &me->solo, &busy);
+	}
+
+	/* all together */
+	pthread_barrier_wait(&h->barrier);
+	instance_loop(kernel, length, &me->colo, &busy);
+	__atomic_add_fetch(&h->done, 1, __ATOMIC_RELEASE);
+	for (long int iter = 0;
+	     __atomic_load_n(&h->done, __ATOMIC_ACQUIRE) < num_instances;
+	     iter++)
+		mixed_step(kernel, iter, &busy);
+
+	nrmb_finalize();
+	me->err = mixed_check();
+	return me->err;
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - number of instances
+	 * - kernel of the instances (triad, ep, is or cg), with an optional
+	 *   problem size after a colon
+	 * - number of steps, or duration, of each timed loop
+	 */
+	int num_instances, num_cpus = 0, per_instance;
+	int cpus[HARNESS_CPUS];
+	enum mixed_kernel kernel;
+	const char *length;
+	struct harness *h;
+	size_t hsize;
+	pthread_barrierattr_t attr;
+	cpu_set_t set;
+	char key[128];
+	int err = 0;
+
+	assert(argc == 4);
+	errno = 0;
+	num_instances = strtol(argv[1], NULL, 0);
+	assert(!errno && num_instances > 0);
+	kernel = mixed_parse(argv[2]);
+	assert(kernel != MIXED_IDLE);
+	length = argv[3];
+
+	/* split the CPUs we may run on into disjoint sets, instances share
+	 * CPUs only when there are more of them than CPUs.
+	 */
+	sched_getaffinity(0, sizeof(set), &set);
+	for (int c = 0; c < CPU_SETSIZE && num_cpus < HARNESS_CPUS; c++)
+		if (CPU_ISSET(c, &set))
+			cpus[num_cpus++] = c;
+	per_instance = num_cpus / num_instances;
+	if (per_instance == 0) {
+		fprintf(stderr, "colocation: %d instances on %d CPUs, instances share CPUs\n",
+			num_instances, num_cpus);
+		per_instance = 1;
+	}
+
+	hsize = sizeof(struct harness) + num_instances * sizeof(struct instance);
+	h = mmap(NULL, hsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+		 -1, 0);
+	assert(h != MAP_FAILED);
+	pthread_barrierattr_init(&attr);
+	pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_barrier_init(&h->barrier, &attr, num_instances);
+	pthread_barrierattr_destroy(&attr);
+	h->done = 0;
+	for (int i = 0; i < num_instances; i++) {
+		struct instance *in = &h->instances[i];
+		in->num_cpus = per_instance;
+		for (int c = 0; c < per_instance; c++)
+			in->cpus[c] = cpus[(i * per_instance + c) % num_cpus];
+	}
+
+	fflush(stdout);
+	pid_t *pids = calloc(num_instances, sizeof(pid_t));
+	assert(pids != NULL);
+	for (int i = 0; i < num_instances; i++) {
+		pids[i] = fork();
+		assert(pids[i] >= 0);
+		if (pids[i] == 0)
+			exit(instance_main(h, i, num_instances, kernel, length,
+					   argv[0]));
+	}
+	/* an instance that dies before all of them are done leaves the
+	 * others waiting on the barrier or for it to be done, kill them.
+	 */
+	for (int i = 0; i < num_instances; i++) {
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		assert(pid > 0);
+		if (WIFEXITED(status) && (WEXITSTATUS(status) == 0 ||
+		    __atomic_load_n(&h->done, __ATOMIC_ACQUIRE) == num_instances)) {
+			err = err || WEXITSTATUS(status);
+			continue;
+		}
+		for (int j = 0; j < num_instances; j++)
+			if (pids[j] == pid)
+				fprintf(stderr, "colocation: instance %d died, stopping the others\n",
+					j);
+			else
+				kill(pids[j], SIGKILL);
+		while (waitpid(-1, NULL, 0) > 0)
+			;
+		return EXIT_FAILURE;
+	}
+
+	/* report the configuration and timings: throughput is in steps per
+	 * second, and in MiB/s for triad, from the average step time. The
+	 * slowdown of an instance is its average step time together over
+	 * alone.
+	 */
+	double bytes = mixed_bytes(kernel);
+	double solo_total = 0.0, colo_total = 0.0;
+
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: co-located instances, %s kernel\n",
+		mixed_name(kernel));
+	fprintf(stdout, "Kernel:              %s (size %zu)\n",
+		mixed_name(kernel), mixed_size(kernel));
+	fprintf(stdout, "Kernel was executed: %s times.\n", length);
+	fprintf(stdout, "Number of instances: %d\n", num_instances);
+	fprintf(stdout, "CPUs per instance:   %d\n", per_instance);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"co-located instances");
+	nrmb_report_config_string(report, "kernel", mixed_name(kernel));
+	nrmb_report_config_int(report, "size", mixed_size(kernel));
+	nrmb_report_config_string(report, "times", length);
+	nrmb_report_config_int(report, "instances", num_instances);
+	nrmb_report_config_int(report, "cpus_per_instance", per_instance);
+
+	for (int i = 0; i < num_instances; i++) {
+		struct instance *in = &h->instances[i];
+		double solo = 1.0E+09 / nrmb_hist_mean(&in->solo);
+		double colo = 1.0E+09 / nrmb_hist_mean(&in->colo);
+		double slowdown = solo / colo;
+
+		solo_total += solo;
+		colo_total += colo;
+		fprintf(stdout, "Instance %3d: CPUs: %3d-%-3d steps: %6" PRIu64 " %6" PRIu64 " Throughput (steps/s): alone: %10.3f together: %10.3f slowdown: %6.3f\n",
+			i, in->cpus[0], in->cpus[in->num_cpus-1],
+			in->solo.count, in->colo.count, solo, colo, slowdown);
+		if (bytes > 0.0)
+			fprintf(stdout, "Instance %3d: Perf (MiB/s): alone: %12.6f together: %12.6f\n",
+				i, 1.0E-06 * bytes * solo,
+				1.0E-06 * bytes * colo);
+
+		snprintf(key, sizeof(key), "Instance %d alone", i);
+		nrmb_report_kernel(report, key, &in->solo, bytes);
+		snprintf(key, sizeof(key), "Instance %d together", i);
+		nrmb_report_kernel(report, key, &in->colo, bytes);
+		snprintf(key, sizeof(key), "instance_%d_slowdown", i);
+		nrmb_report_metric(report, key, slowdown);
+	}
+	fprintf(stdout, "Aggregate: Throughput (steps/s): alone: %10.3f together: %10.3f slowdown: %6.3f\n",
+		solo_total, colo_total, solo_total / colo_total);
+	if (bytes > 0.0)
+		fprintf(stdout, "Aggregate: Perf (MiB/s): alone: %12.6f together: %12.6f\n",
+			1.0E-06 * bytes * solo_total,
+			1.0E-06 * bytes * colo_total);
+	nrmb_report_metric(report, "throughput_alone", solo_total);
+	nrmb_report_metric(report, "throughput_together", colo_total);
+	nrmb_report_metric(report, "slowdown", solo_total / colo_total);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: each instance checked its own results */
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return err;
+#endif
+}
@@ -0,0 +1,178 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <string.h>
+
+/* Log-bucketed histogram: values below NRMB_HIST_SUB are counted exactly,
+ * larger values are grouped by their most significant bit, and each group is
+ * split linearly into NRMB_HIST_SUB buckets using the next bits. The relative
+ * error of a bucket is thus bounded by 1/NRMB_HIST_SUB, whatever the value.
+ */
+#define NRMB_HIST_SUB (1 << NRMB_HIST_SUB_BITS)
+
+static size_t nrmb_hist_index(uint64_t v)
+{
+	if (v < NRMB_HIST_SUB)
+		return v;
+	int msb = 63 - __builtin_clzll(v);
+	int group = msb - NRMB_HIST_SUB_BITS + 1;
+	return group * NRMB_HIST_SUB +
+		((v >> (msb - NRMB_HIST_SUB_BITS)) & (NRMB_HIST_SUB - 1));
+}
+
+/* middle of the range of values counted by a bucket */
+static int64_t nrmb_hist_value(size_t idx)
+{
+	if (idx < NRMB_HIST_SUB)
+		return idx;
+	size_t group = idx / NRMB_HIST_SUB;
+	uint64_t low = (uint64_t)(NRMB_HIST_SUB + idx % NRMB_HIST_SUB) <<
+		(group - 1);
+	return low + (((uint64_t)1 << (group - 1)) >> 1);
+}
+
+void nrmb_hist_init(struct nrmb_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = INT64_MAX;
+}
+
+void nrmb_hist_record(struct nrmb_hist *h, int64_t value)
+{
+	if (value < 0)
+		value = 0;
+	h->count++;
+	h->sum += value;
+	h->min = NRMB_MIN(value, h->min);
+	h->max = NRMB_MAX(value, h->max);
+	h->buckets[nrmb_hist_index(value)]++;
+}
+
+void nrmb_hist_merge(struct nrmb_hist *h, const struct nrmb_hist *other)
+{
+	h->count += other->count;
+	h->sum += other->sum;
+	h->min = NRMB_MIN(other->min, h->min);
+	h->max = NRMB_MAX(other->max, h->max);
+	for (size_t i = 0; i < NRMB_HIST_BUCKETS; i++)
+		h->buckets[i] += other->buckets[i];
+}
+
+int64_t nrmb_hist_percentile(const struct nrmb_hist *h, double p)
+{
+	uint64_t rank, seen = 0;
+
+	if (h->count == 0)
+		return 0;
+	rank = (uint64_t)(p / 100.0 * h->count + 0.5);
+	rank = NRMB_MAX(rank, 1);
+	for (size_t i = 0; i < NRMB_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank) {
+			int64_t v = nrmb_hist_value(i);
+			return NRMB_MIN(NRMB_MAX(v, h->min), h->max);
+		}
+	}
+	return h->max;
+}
+
+double nrmb_hist_mean(const struct nrmb_hist *h)
+{
+	return h->count ? (double)h->sum / h->count : 0.0;
+}
+
+void nrmb_hist_print(FILE *out, const char *name, const struct nrmb_hist *h)
+{
+	if (name != NULL)
+		fprintf(out, "%s ", name);
+	fprintf(out, "Time (s): p50: %11.6f p90: %11.6f p99: %11.6f p99.9: %11.6f\n",
+		1.0E-09 * nrmb_hist_percentile(h, 50.0),
+		1.0E-09 * nrmb_hist_percentile(h, 90.0),
+		1.0E-09 * nrmb_hist_percentile(h, 99.0),
+		1.0E-09 * nrmb_hist_percentile(h, 99.9));
+}
+
+/* Per-thread timings: each thread records the time of its own share of a
+ * kernel in its own histogram, so that recording needs no synchronization.
+ * The spread is computed over the average time of each thread, the imbalance
+ * being the slowest thread over the average thread: 1.0 when perfectly
+ * balanced, and how much faster the kernel would run if it were.
+ */
+void nrmb_thread_hist_init(struct nrmb_thread_hist *t, int num_threads)
+{
+	t->num_threads = num_threads;
+	t->hist = malloc(num_threads * sizeof(struct nrmb_hist));
+	assert(t->hist != NULL);
+	for (int i = 0; i < num_threads; i++)
+		nrmb_hist_init(&t->hist[i]);
+}
+
+void nrmb_thread_hist_reset(struct nrmb_thread_hist *t)
+{
+	for (int i = 0; i < t->num_threads; i++)
+		nrmb_hist_init(&t->hist[i]);
+}
+
+void nrmb_thread_hist_free(struct nrmb_thread_hist *t)
+{
+	free(t->hist);
+	t->hist = NULL;
+	t->num_threads = 0;
+}
+
+void nrmb_thread_hist_record(struct nrmb_thread_hist *t, int tid,
+			     int64_t value)
+{
+	assert(tid >= 0 && tid < t->num_threads);
+	nrmb_hist_record(&t->hist[tid], value);
+}
+
+void nrmb_thread_hist_stats(const struct nrmb_thread_hist *t, double *min,
+			    double *avg, double *max, double *imbalance)
+{
+	double lo = DBL_MAX, hi = 0.0, sum = 0.0;
+	int n = 0;
+
+	for (int i = 0; i < t->num_threads; i++) {
+		double mean;
+		if (t->hist[i].count == 0)
+			continue;
+		mean = nrmb_hist_mean(&t->hist[i]);
+		lo = NRMB_MIN(lo, mean);
+		hi = NRMB_MAX(hi, mean);
+		sum += mean;
+		n++;
+	}
+	if (n == 0 || sum == 0.0) {
+		*min = *avg = *max = 0.0;
+		*imbalance = 1.0;
+		return;
+	}
+	*min = lo;
+	*avg = sum / n;
+	*max = hi;
+	*imbalance = hi / *avg;
+}
+
+void nrmb_thread_hist_print(FILE *out, const char *name,
+			    const struct nrmb_thread_hist *t)
+{
+	double min, avg, max, imbalance;
+
+	nrmb_thread_hist_stats(t, &min, &avg, &max, &imbalance);
+	if (name != NULL)
+		fprintf(out, "%s ", name);
+	fprintf(out, "Thread time (s): min: %11.6f avg: %11.6f max: %11.6f imbalance: %6.3f\n",
+		1.0E-09 * min, 1.0E-09 * avg, 1.0E-09 * max, imbalance);
+}
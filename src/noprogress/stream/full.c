@@ -14,6 +14,8 @@
 
 #include <nrm.h>
 
+#include "progress/ones/stream/common.h"
+
 static double *a, *b, *c;
 
 int main(int argc, char **argv)
@@ -27,9 +29,8 @@ int main(int argc, char **argv)
 	double scalar = 3.0;
 
 	/* needed for performance measurement */
-	int64_t sumtime[4] = {0,0,0,0};
-	int64_t mintime[4] = {INT64_MAX, INT64_MAX, INT64_MAX, INT64_MAX};
-	int64_t maxtime[4] = {0, 0, 0, 0};
+	struct nrmb_hist hist[4];
+	struct nrmb_thread_hist threads[4];
 	const char *names[4] = {"Copy", "Scale", "Add", "Triad"};
 	size_t bytes[4] = {2, 2, 3, 3};
 	nrm_time_t progress_start, progress_end;
@@ -45,9 +46,7 @@ int main(int argc, char **argv)
 	errno = 0;
 	array_size = strtoull(argv[1], NULL, 0);
 	assert(!errno);
-	errno = 0;
-	times = strtol(argv[2], NULL, 0);
-	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
 
 	/* ensure that OpenMP is giving us the right number of threads */
 #pragma omp parallel
@@ -62,12 +61,14 @@ int main(int argc, char **argv)
 
 	/* allocate the arrays and initialize them. Note that we expect the
 	 * first-touch policy of Linux to result in the arrays being properly
-	 * balanced between threads/numa-nodes
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
 	 */
+	nrmb_numa_init();
 	memory_size = array_size * sizeof(double);
-	a = malloc(memory_size);
-	b = malloc(memory_size);
-	c = malloc(memory_size);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
 
 #pragma omp parallel for
 	for(size_t i = 0; i < array_size; i++)
@@ -93,40 +94,39 @@ int main(int argc, char **argv)
 #pragma omp parallel for
 	for(size_t i = 0; i < array_size; i++)
 		a[i] = b[i] + scalar*c[i];
+	long int passes = 1;
 
-	for(long int iter = 0; iter < times; iter++)
+	for(size_t i = 0; i < 4; i++) {
+		nrmb_hist_init(&hist[i]);
+		nrmb_thread_hist_init(&threads[i], num_threads);
+	}
+
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
 	{
 		int64_t time;
 
+		stream_cycle_reset(a, b, c, array_size, &passes);
+		passes++;
+
 #define TSTART(k) nrm_time_gettime(&start)
 #define TEND(i) do { \
 		nrm_time_gettime(&end); \
 		time = nrm_time_diff(&start, &end); \
-		sumtime[i] += time; \
-		mintime[i] = NRMB_MIN(time, mintime[i]); \
-		maxtime[i] = NRMB_MAX(time, maxtime[i]); \
+		nrmb_hist_record(&hist[i], time); \
 	} while(0)
 
 		/* the actual benchmarks */
 		TSTART(0);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		c[i] = a[i];
+		STREAM_TIMED_FOR(&threads[0], array_size, c[i] = a[i]);
 		TEND(0);
 		TSTART(1);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		b[i] = scalar*c[i];
+		STREAM_TIMED_FOR(&threads[1], array_size, b[i] = scalar*c[i]);
 		TEND(1);
 		TSTART(2);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		c[i] = a[i] + b[i];
+		STREAM_TIMED_FOR(&threads[2], array_size, c[i] = a[i] + b[i]);
 		TEND(2);
 		TSTART(3);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		a[i] = b[i] + scalar*c[i];
+		STREAM_TIMED_FOR(&threads[3], array_size, a[i] = b[i] + scalar*c[i]);
 		TEND(3);
 
 	}
@@ -138,7 +138,7 @@ int main(int argc, char **argv)
 	/* report the configuration and timings */
 	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
 	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
-	fprintf(stdout, "Description: one progress per iteration, Stream benchmark\n");
+	fprintf(stdout, "Description: no progress, Stream benchmark\n");
 	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
 	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
 		(double) memory_size /1024.0/1024.0);
@@ -148,36 +148,63 @@ int main(int argc, char **argv)
 
 	for(size_t i = 0; i < 4; i++) {
 	fprintf(stdout, "%s Time (s): avg: %11.6f min: %11.6f max: %11.6f\n",
-		names[i], 1.0E-09 * sumtime[i]/times, 1.0E-09 * mintime[i],
-		1.0E-09 * maxtime[i]);
+		names[i], 1.0E-09 * nrmb_hist_mean(&hist[i]),
+		1.0E-09 * hist[i].min, 1.0E-09 * hist[i].max);
+	nrmb_hist_print(stdout, names[i], &hist[i]);
+	nrmb_thread_hist_print(stdout, names[i], &threads[i]);
 	fprintf(stdout, "%s Perf (MiB/s): avg: %12.6f best: %12.6f\n", names[i],
-		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * sumtime[i]/times),
-		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * mintime[i]));
+		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * nrmb_hist_mean(&hist[i])),
+		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * hist[i].min));
+	}
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"no progress, Stream benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_metric(report, "progress_time", 1.0E-09 * progress_time);
+	for(size_t i = 0; i < 4; i++) {
+		nrmb_report_kernel(report, names[i], &hist[i],
+				   (double)bytes[i] * memory_size);
+		nrmb_report_threads(report, names[i], &threads[i]);
+	}
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+		stream_numa_report(stdout, report, "Triad", stream_triad,
+				   a, b, c, scalar,
+				   array_size, 3, times);
 	}
 
 #ifdef ENABLE_POST_VALIDATION
 	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
 	err = 0;
-	double ai = 1.0, bi = 2.0, ci = 0.0;
-	for(long int i = 0; i < times+1; i++) {
-		ci = ai;
-		bi = scalar*ci;
-		ci = ai+bi;
-		ai = bi+scalar*ci;
-	}
-	for(size_t i = 0; i < array_size && err == 0; i++) {
-		err = err || !nrmb_check_double(ai, a[i], 2);
-		err = err || !nrmb_check_double(bi, b[i], 2);
-		err = err || !nrmb_check_double(ci, c[i], 2);
-	}
+	double ai, bi, ci;
+	stream_cycle_replay(scalar, passes, &ai, &bi, &ci);
+	err = err || !nrmb_check_array(ai, a, array_size, 2);
+	err = err || !nrmb_check_array(bi, b, array_size, 2);
+	err = err || !nrmb_check_array(ci, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
 
 	if(err)
 		fprintf(stdout, "VALIDATION FAILED!!!!\n");
 	else
 		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
 	return err;
 #else
 	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
 	return 0;
 #endif
 }
@@ -29,9 +29,164 @@
 
 int nrmb_check_double(double ref, double value, int bits);
 int nrmb_check_double_prec(double ref, double value, double prec);
+/* same as nrmb_check_double, over n values in parallel, against a single
+ * reference or one per value.
+ */
+int nrmb_check_array(double ref, const double *values, size_t n, int bits);
+int nrmb_check_arrays(const double *refs, const double *values, size_t n,
+		      int bits);
 
 int nrmb_init(const char *);
 int nrmb_finalize();
+/* safe to call from any thread of a (non-nested) parallel region: worker
+ * threads only accumulate into their own counter, the master thread merges
+ * all counters before each rate-limited send to the NRM.
+ */
 int nrmb_send_progress(double value);
 
+/* override the minimum time between two progress sends, returns the previous
+ * value. Only meant to measure the cost of the reporting path itself.
+ */
+int64_t nrmb_set_ratelimit(int64_t ns);
+
+/* iteration count argument of a benchmark: a number of iterations, or a
+ * wall-clock duration with a unit suffix (ms, s, m or h, as in 30s), in which
+ * case the count is unbounded and loops run until the duration elapsed.
+ */
+long int nrmb_parse_times(const char *arg);
+/* duration part of the above, in nanoseconds, 0 when arg is a plain count.
+ * Does not change the run mode, for callers that handle deadlines themselves.
+ */
+int64_t nrmb_parse_duration(const char *arg);
+/* duration given to nrmb_parse_times in nanoseconds, 0 for a count */
+int64_t nrmb_run_duration(void);
+/* whether the duration elapsed since iteration 0 of the current loop, only
+ * ever checked between iterations.
+ */
+int nrmb_run_expired(long int iter);
+/* loop condition: false after *times iterations or once the duration
+ * expired, *times then holds the number of iterations actually run.
+ */
+int nrmb_run_next(long int iter, long int *times);
+
+/* range of [0, n) assigned to the calling thread by a schedule(static) loop,
+ * for parallel regions that need to walk their share of an array themselves.
+ */
+void nrmb_static_range(size_t n, size_t *start, size_t *end);
+
+/* splitmix64, good enough to shuffle and cheap to seed per thread */
+uint64_t nrmb_rand(uint64_t *state);
+
+/* low-overhead latency recorder, in nanoseconds, with log-sized buckets so
+ * that percentiles stay accurate to a few percent over any range of values.
+ */
+#define NRMB_HIST_SUB_BITS 5
+#define NRMB_HIST_BUCKETS ((64 - NRMB_HIST_SUB_BITS + 1) << NRMB_HIST_SUB_BITS)
+
+struct nrmb_hist {
+	uint64_t count;
+	int64_t sum;
+	int64_t min;
+	int64_t max;
+	uint64_t buckets[NRMB_HIST_BUCKETS];
+};
+
+void nrmb_hist_init(struct nrmb_hist *h);
+void nrmb_hist_record(struct nrmb_hist *h, int64_t value);
+void nrmb_hist_merge(struct nrmb_hist *h, const struct nrmb_hist *other);
+int64_t nrmb_hist_percentile(const struct nrmb_hist *h, double p);
+double nrmb_hist_mean(const struct nrmb_hist *h);
+/* print p50/p90/p99/p99.9 in seconds, on a line prefixed by name if any */
+void nrmb_hist_print(FILE *out, const char *name, const struct nrmb_hist *h);
+
+/* one histogram per OpenMP thread, each thread recording the time of its own
+ * share of a kernel. Stats are over the average time of each thread, with the
+ * imbalance being the slowest thread over the average one.
+ */
+struct nrmb_thread_hist {
+	int num_threads;
+	struct nrmb_hist *hist;
+};
+
+void nrmb_thread_hist_init(struct nrmb_thread_hist *t, int num_threads);
+/* clear the histograms for reuse, free releases them */
+void nrmb_thread_hist_reset(struct nrmb_thread_hist *t);
+void nrmb_thread_hist_free(struct nrmb_thread_hist *t);
+void nrmb_thread_hist_record(struct nrmb_thread_hist *t, int tid,
+			     int64_t value);
+void nrmb_thread_hist_stats(const struct nrmb_thread_hist *t, double *min,
+			    double *avg, double *max, double *imbalance);
+/* print min/avg/max thread time and imbalance, prefixed by name if any */
+void nrmb_thread_hist_print(FILE *out, const char *name,
+			    const struct nrmb_thread_hist *t);
+
+/* NUMA placement of the benchmark arrays, selected by NRMB_NUMA: local
+ * (first-touch), interleave, node:<N> or remote:<cpu node>:<memory node>.
+ * init must be called before any allocation, it binds the OpenMP threads for
+ * the node and remote modes. place sets the policy of a page-aligned range
+ * before first touch, placed tells whether there is a policy to set at all.
+ */
+enum nrmb_numa_mode {
+	NRMB_NUMA_DEFAULT,
+	NRMB_NUMA_LOCAL,
+	NRMB_NUMA_INTERLEAVE,
+	NRMB_NUMA_NODE,
+	NRMB_NUMA_REMOTE,
+};
+
+enum nrmb_numa_mode nrmb_numa_init(void);
+enum nrmb_numa_mode nrmb_numa_mode(void);
+const char *nrmb_numa_spec(void);
+void nrmb_numa_place(void *p, size_t size);
+int nrmb_numa_placed(void);
+int nrmb_numa_num_nodes(void);
+/* node of the calling thread and of the page holding p, -1 if unknown */
+int nrmb_numa_thread_node(void);
+int nrmb_numa_node_of(const void *p);
+/* print where the pages of an array of n elements are, returns whether that
+ * matches the requested placement.
+ */
+int nrmb_numa_check(FILE *out, const char *name, const void *p, size_t n,
+		    size_t elem_size);
+
+/* allocator for the benchmark arrays, configured by NRMB_PAGES (malloc, 4k,
+ * thp, 2m or 1g) and NRMB_ALIGN (cacheline, page or a number of bytes), and
+ * placed according to NRMB_NUMA. Arrays must be released with nrmb_free.
+ */
+void *nrmb_alloc(size_t size);
+void *nrmb_calloc(size_t n, size_t size);
+void nrmb_free(void *p);
+const char *nrmb_alloc_spec(void);
+/* page size backing p and the fraction of it on huge pages, as seen by the
+ * kernel, so only meaningful once the memory has been touched.
+ */
+size_t nrmb_page_size(const void *p, double *huge);
+
+/* structured results, emitted as JSON or CSV at finalize according to the
+ * NRMB_REPORT and NRMB_REPORT_FILE environment variables. Kernel bytes are
+ * the memory traffic of one run, 0 if bandwidth is meaningless.
+ */
+struct nrmb_report;
+
+struct nrmb_report *nrmb_report_create(const char *benchmark,
+				       const char *description);
+void nrmb_report_config_int(struct nrmb_report *r, const char *key,
+			    long long value);
+void nrmb_report_config_double(struct nrmb_report *r, const char *key,
+			       double value);
+void nrmb_report_config_string(struct nrmb_report *r, const char *key,
+			       const char *value);
+void nrmb_report_metric(struct nrmb_report *r, const char *key, double value);
+void nrmb_report_kernel(struct nrmb_report *r, const char *name,
+			const struct nrmb_hist *h, double bytes);
+/* <name>_thread_min, _thread_avg, _thread_max and _imbalance metrics */
+void nrmb_report_threads(struct nrmb_report *r, const char *name,
+			 const struct nrmb_thread_hist *t);
+void nrmb_report_validation(struct nrmb_report *r, int err);
+int nrmb_report_finalize(struct nrmb_report *r);
+
+/* print and report the page size obtained for an array */
+void nrmb_alloc_report(FILE *out, struct nrmb_report *r, const char *name,
+		       const void *p);
+
 #endif
@@ -0,0 +1,206 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <string.h>
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+#endif
+
+/* Explicit NUMA placement: NRMB_NUMA selects where the benchmark arrays live
+ * and, for the node and remote modes, binds the OpenMP threads to a node.
+ * Without it, benchmarks keep relying on malloc and the first-touch policy.
+ */
+static enum nrmb_numa_mode numa_mode = NRMB_NUMA_DEFAULT;
+static const char *numa_spec = "default";
+static int numa_cpu_node = -1;
+static int numa_mem_node = -1;
+
+/* number of pages of each thread share looked up by the placement check */
+#define NRMB_NUMA_CHECK_PAGES 64
+
+enum nrmb_numa_mode nrmb_numa_init(void)
+{
+	const char *spec = getenv("NRMB_NUMA");
+	int cpu, mem;
+
+	if (spec == NULL || *spec == '\0')
+		return numa_mode;
+
+	if (!strcmp(spec, "local"))
+		numa_mode = NRMB_NUMA_LOCAL;
+	else if (!strcmp(spec, "interleave"))
+		numa_mode = NRMB_NUMA_INTERLEAVE;
+	else if (sscanf(spec, "node:%d", &mem) == 1) {
+		numa_mode = NRMB_NUMA_NODE;
+		numa_cpu_node = mem;
+		numa_mem_node = mem;
+	}
+	else if (sscanf(spec, "remote:%d:%d", &cpu, &mem) == 2) {
+		numa_mode = NRMB_NUMA_REMOTE;
+		numa_cpu_node = cpu;
+		numa_mem_node = mem;
+	}
+	else
+		assert(0 && "unknown NRMB_NUMA placement");
+	numa_spec = spec;
+
+#ifdef HAVE_LIBNUMA
+	assert(numa_available() != -1);
+	assert(numa_cpu_node <= numa_max_node());
+	assert(numa_mem_node <= numa_max_node());
+	if (numa_cpu_node >= 0) {
+#pragma omp parallel
+		{
+			int err = numa_run_on_node(numa_cpu_node);
+			assert(err == 0);
+		}
+	}
+#else
+	assert(0 && "NRMB_NUMA requires libnuma support");
+#endif
+	return numa_mode;
+}
+
+enum nrmb_numa_mode nrmb_numa_mode(void)
+{
+	return numa_mode;
+}
+
+const char *nrmb_numa_spec(void)
+{
+	return numa_spec;
+}
+
+void nrmb_numa_place(void *p, size_t size)
+{
+#ifdef HAVE_LIBNUMA
+	switch (numa_mode) {
+	case NRMB_NUMA_INTERLEAVE:
+		numa_interleave_memory(p, size, numa_all_nodes_ptr);
+		break;
+	case NRMB_NUMA_NODE:
+	case NRMB_NUMA_REMOTE:
+		numa_tonode_memory(p, size, numa_mem_node);
+		break;
+	default:
+		break;
+	}
+#else
+	(void)p;
+	(void)size;
+#endif
+}
+
+int nrmb_numa_placed(void)
+{
+	return numa_mode == NRMB_NUMA_INTERLEAVE || numa_mode == NRMB_NUMA_NODE
+		|| numa_mode == NRMB_NUMA_REMOTE;
+}
+
+int nrmb_numa_num_nodes(void)
+{
+#ifdef HAVE_LIBNUMA
+	if (numa_available() != -1)
+		return numa_max_node() + 1;
+#endif
+	return 1;
+}
+
+int nrmb_numa_thread_node(void)
+{
+#ifdef HAVE_LIBNUMA
+	if (numa_available() != -1)
+		return numa_node_of_cpu(sched_getcpu());
+#endif
+	return -1;
+}
+
+int nrmb_numa_node_of(const void *p)
+{
+#ifdef HAVE_LIBNUMA
+	void *page = (void *)p;
+	int status = -1;
+
+	if (move_pages(0, 1, &page, NULL, &status, 0) == 0 && status >= 0)
+		return status;
+#else
+	(void)p;
+#endif
+	return -1;
+}
+
+int nrmb_numa_check(FILE *out, const char *name, const void *p, size_t n,
+		    size_t elem_size)
+{
+	int num_nodes = nrmb_numa_num_nodes();
+	size_t *pages = calloc(num_nodes, sizeof(size_t));
+	size_t sampled = 0, matched = 0;
+	int ok;
+
+	assert(pages != NULL);
+
+	/* each thread looks up a sample of the pages in its schedule(static)
+	 * share, so that the local mode can be checked against the node the
+	 * thread actually runs on.
+	 */
+#pragma omp parallel reduction(+:sampled, matched)
+	{
+		size_t start, end, stride;
+		int expected = numa_mem_node;
+		const char *base = p;
+
+		nrmb_static_range(n, &start, &end);
+		if (numa_mode == NRMB_NUMA_LOCAL)
+			expected = nrmb_numa_thread_node();
+		stride = NRMB_MAX((end - start) / NRMB_NUMA_CHECK_PAGES, 1);
+		for (size_t i = start; i < end; i += stride) {
+			int node = nrmb_numa_node_of(base + i * elem_size);
+			if (node < 0 || node >= num_nodes)
+				continue;
+#pragma omp atomic update
+			pages[node]++;
+			sampled++;
+			if (numa_mode == NRMB_NUMA_INTERLEAVE || node == expected)
+				matched++;
+		}
+	}
+
+	/* a few pages might land elsewhere (page cache pressure, huge page
+	 * boundaries), interleaving only has to spread pages over all the
+	 * nodes with memory.
+	 */
+	ok = sampled > 0 && matched * 100 >= sampled * 95;
+	fprintf(out, "Placement %s:", name);
+	for (int i = 0; i < num_nodes; i++) {
+		if (pages[i] == 0)
+			continue;
+		fprintf(out, " node %d: %5.1f%%", i, 100.0 * pages[i] / sampled);
+	}
+#ifdef HAVE_LIBNUMA
+	if (numa_mode == NRMB_NUMA_INTERLEAVE) {
+		int mem_nodes = numa_num_configured_nodes();
+		for (int i = 0; i < num_nodes; i++) {
+			if (!numa_bitmask_isbitset(numa_all_nodes_ptr, i))
+				continue;
+			ok = ok && pages[i] * mem_nodes * 2 >= sampled;
+		}
+	}
+#endif
+	fprintf(out, " (%s)\n", ok ? "as requested" : "NOT as requested");
+	free(pages);
+	return ok;
+}
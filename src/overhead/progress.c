@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+static double *a, *b, *c;
+
+/* every thread of a team of num_threads calls nrmb_send_progress calls times,
+ * returns the elapsed time in ns.
+ */
+static int64_t progress_calls(int num_threads, long int calls)
+{
+	nrm_time_t start, end;
+
+	nrm_time_gettime(&start);
+#pragma omp parallel num_threads(num_threads)
+	for (long int i = 0; i < calls; i++)
+		nrmb_send_progress(1.0);
+	nrm_time_gettime(&end);
+	return nrm_time_diff(&start, &end);
+}
+
+/* triad where each thread reports progress every k elements of its share of
+ * the array. A k of 0 means no progress at all.
+ */
+static void triad_progress(size_t array_size, size_t k, double scalar)
+{
+#pragma omp parallel
+	{
+		size_t start, end, block = k;
+		nrmb_static_range(array_size, &start, &end);
+		if (k == 0)
+			block = end - start;
+		for (size_t i = start; i < end; i += block) {
+			size_t stop = NRMB_MIN(i + block, end);
+			for (size_t j = i; j < stop; j++)
+				c[j] = a[j] + scalar*b[j];
+			if (k != 0)
+				nrmb_send_progress((double)(stop - i)/array_size);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements, for the triad
+	 * - number of progress calls per thread, for the call rate sweep
+	 * - number of times to run the triad for each progress frequency
+	 */
+	size_t array_size;
+	long int calls, times;
+	double scalar = 3.0;
+
+	/* progress frequencies, in elements per call. 0 is the baseline
+	 * without any progress report.
+	 */
+	size_t freqs[] = {0, 0, 1 << 20, 1 << 16, 1 << 12, 1 << 10, 1 << 8,
+			  1 << 6};
+	const size_t num_freqs = sizeof(freqs)/sizeof(freqs[0]);
+	struct nrmb_hist hist[sizeof(freqs)/sizeof(freqs[0])];
+	nrm_time_t start, end;
+	size_t memory_size;
+	char key[64];
+	int num_threads;
+
+	assert(argc == 4);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	errno = 0;
+	calls = strtol(argv[2], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[3]);
+
+	/* the second entry reports once per thread and per pass, like the
+	 * ones-stream benchmarks do per pass.
+	 */
+	freqs[1] = array_size;
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	memory_size = array_size * sizeof(double);
+	a = malloc(memory_size);
+	b = malloc(memory_size);
+	c = malloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	nrmb_init(argv[0]);
+
+	/* report the configuration first, the sweeps print as they go */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: cost of the progress reporting path\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Calls per thread:    %ld.\n", calls);
+	if (nrmb_run_duration())
+		fprintf(stdout, "Triad was executed:  %.1f s per frequency.\n",
+			1.0E-09 * nrmb_run_duration());
+	else
+		fprintf(stdout, "Triad was executed:  %ld times per frequency.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"cost of the progress reporting path");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "calls", calls);
+	if (!nrmb_run_duration())
+		nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+
+	/* call rate: the rate-limited case never sends, except for the few
+	 * calls that cross the rate limit, the send case has the master
+	 * thread send on every one of its calls.
+	 */
+	for (int send = 0; send < 2; send++) {
+		int64_t ratelimit = 0;
+		if (send)
+			ratelimit = nrmb_set_ratelimit(0);
+		for (int t = 1; ; t = NRMB_MIN(2*t, num_threads)) {
+			int64_t time = progress_calls(t, calls);
+			fprintf(stdout, "Progress %s threads: %3d calls/s: %14.1f ns/call: %10.2f\n",
+				send ? "send   " : "no-send", t,
+				(double)calls * t / (1.0E-09 * time),
+				(double)time / calls);
+			snprintf(key, sizeof(key), "%s_threads_%d_ns_per_call",
+				 send ? "send" : "nosend", t);
+			nrmb_report_metric(report, key, (double)time / calls);
+			if (t == num_threads)
+				break;
+		}
+		if (send)
+			nrmb_set_ratelimit(ratelimit);
+	}
+
+	/* triad slowdown: the warmup run also fixes the baseline for
+	 * validation.
+	 */
+	triad_progress(array_size, 0, scalar);
+	for (size_t f = 0; f < num_freqs; f++) {
+		long int count = times;
+		nrmb_hist_init(&hist[f]);
+		for (long int iter = 0; nrmb_run_next(iter, &count); iter++) {
+			int64_t time;
+			nrm_time_gettime(&start);
+			triad_progress(array_size, freqs[f], scalar);
+			nrm_time_gettime(&end);
+			time = nrm_time_diff(&start, &end);
+			nrmb_hist_record(&hist[f], time);
+		}
+	}
+
+	nrmb_finalize();
+
+	for (size_t f = 0; f < num_freqs; f++) {
+		if (freqs[f] == 0)
+			fprintf(stdout, "Triad progress every:   none ");
+		else
+			fprintf(stdout, "Triad progress every: %6zu ", freqs[f]);
+		fprintf(stdout, "Time (s): avg: %11.6f min: %11.6f p99: %11.6f Perf (MiB/s): best: %12.6f slowdown: %6.3f\n",
+			1.0E-09 * nrmb_hist_mean(&hist[f]),
+			1.0E-09 * hist[f].min,
+			1.0E-09 * nrmb_hist_percentile(&hist[f], 99.0),
+			(3.0E-06 * memory_size)/ (1.0E-09 * hist[f].min),
+			nrmb_hist_mean(&hist[f])/nrmb_hist_mean(&hist[0]));
+		if (freqs[f] == 0)
+			snprintf(key, sizeof(key), "Triad every none");
+		else
+			snprintf(key, sizeof(key), "Triad every %zu", freqs[f]);
+		nrmb_report_kernel(report, key, &hist[f], 3.0 * memory_size);
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
+	err = !nrmb_check_array(7.0, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -25,18 +25,19 @@
 #include "common.h"
 
 static double *A, *b, *x;
+static struct nrmb_hist iter_hist;
 int LOG;
 
-void bicgstab(double *A, double *b, double *x, int n, int maxiter)
+void bicgstab(double *A, double *b, double *x, int n, long int maxiter)
 {
     int total_iterations = 0;
 
-    double *r = (double *)malloc(n * sizeof(double));
-    double *r_hat = (double *)malloc(n * sizeof(double));
-    double *v = (double *)calloc(n, sizeof(double));
-    double *p = (double *)malloc(n * sizeof(double));
-    double *s = (double *)malloc(n * sizeof(double));
-    double *t = (double *)malloc(n * sizeof(double));
+    double *r = (double *)nrmb_alloc(n * sizeof(double));
+    double *r_hat = (double *)nrmb_alloc(n * sizeof(double));
+    double *v = (double *)nrmb_calloc(n, sizeof(double));
+    double *p = (double *)nrmb_alloc(n * sizeof(double));
+    double *s = (double *)nrmb_alloc(n * sizeof(double));
+    double *t = (double *)nrmb_alloc(n * sizeof(double));
     double alpha, omega, rho, rho_prime = 1.0;
 
     nrmb_send_progress(1.0);
@@ -48,8 +49,12 @@ void bicgstab(double *A, double *b, double *x, int n, int maxiter)
 
     nrmb_send_progress(1.0);
 
-    for (int iter = 0; iter < n && iter < maxiter; ++iter)
+    for (int iter = 0; iter < n && iter < maxiter &&
+         !nrmb_run_expired(iter); ++iter)
     {
+        nrm_time_t iter_start, iter_end;
+        nrm_time_gettime(&iter_start);
+
         rho = cblas_ddot(n, r_hat, 1, r, 1);
 
         if (iter == 0)
@@ -79,6 +84,10 @@ void bicgstab(double *A, double *b, double *x, int n, int maxiter)
         if (s_norm < 1e-10)
         {
             cblas_daxpy(n, alpha, p, 1, x, 1);
+            /* the converging iteration counts as much as the others */
+            total_iterations = iter;
+            nrm_time_gettime(&iter_end);
+            nrmb_hist_record(&iter_hist, nrm_time_diff(&iter_start, &iter_end));
             break;
         }
 
@@ -105,14 +114,16 @@ void bicgstab(double *A, double *b, double *x, int n, int maxiter)
         }
 		total_iterations = iter;
 	nrmb_send_progress(1.0);
+        nrm_time_gettime(&iter_end);
+        nrmb_hist_record(&iter_hist, nrm_time_diff(&iter_start, &iter_end));
     }
 
-    free(r);
-    free(r_hat);
-    free(v);
-    free(p);
-    free(s);
-    free(t);
+    nrmb_free(r);
+    nrmb_free(r_hat);
+    nrmb_free(v);
+    nrmb_free(p);
+    nrmb_free(s);
+    nrmb_free(t);
 
 	printf("BiCGStab total iterations: %d\n", total_iterations);
 }
@@ -124,13 +135,14 @@ int main(int argc, char *argv[])
     int n = atoi(argv[1]);
     char *conditionning = argv[2];
     LOG = atoi(argv[3]);
-    int maxiter = atoi(argv[4]);
+    long int maxiter = nrmb_parse_times(argv[4]);
 
-    A = (double *)malloc(n * n * sizeof(double));
-    b = (double *)malloc(n * sizeof(double));
-    x = (double *)malloc(n * sizeof(double));
+    A = (double *)nrmb_alloc(n * n * sizeof(double));
+    b = (double *)nrmb_alloc(n * sizeof(double));
+    x = (double *)nrmb_alloc(n * sizeof(double));
 
     nrmb_init(argv[0]);
+    nrmb_hist_init(&iter_hist);
     nrmb_send_progress(1.0);
 
     if (strcmp(conditionning, "good") == 0)
@@ -159,10 +171,25 @@ int main(int argc, char *argv[])
     time = (finish.tv_sec - start.tv_sec);
     time += (finish.tv_usec - start.tv_usec)/1e6;
 	printf("BiCGStab time: %f\n", time);
+	nrmb_hist_print(stdout, "BiCGStab iteration", &iter_hist);
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, BiCGStab solver");
+	nrmb_report_config_int(report, "n", n);
+	nrmb_report_config_string(report, "conditioning", conditionning);
+	if (!nrmb_run_duration())
+		nrmb_report_config_int(report, "maxiter", maxiter);
+	nrmb_report_config_int(report, "threads", omp_get_max_threads());
+	nrmb_report_kernel(report, "BiCGStab iteration", &iter_hist, 0.0);
+	nrmb_report_metric(report, "time", time);
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(stdout, report, "A", A);
+	nrmb_report_finalize(report);
     
-	free(A);
-    free(b);
-    free(x);
+	nrmb_free(A);
+    nrmb_free(b);
+    nrmb_free(x);
 
     return 0;
 }
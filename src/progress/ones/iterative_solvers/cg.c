@@ -25,63 +25,40 @@
 #include "common.h"
 
 static double *A, *b, *x;
+static struct nrmb_hist iter_hist;
 int LOG;
 
 
-void conjugate_gradient(double *A, double *b, double *x, int n, int maxiter)
+void conjugate_gradient(double *A, double *b, double *x, int n, long int maxiter)
 {
     int total_iterations = 0;
-
-	double *r, *p, *Ap;
-    r = (double *)malloc(n * sizeof(double));
-    p = (double *)malloc(n * sizeof(double));
-    Ap = (double *)malloc(n * sizeof(double));
+    struct cg_state cg;
 
     nrmb_send_progress(1.0);
 
-    cblas_dcopy(n, b, 1, r, 1);
-    cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, -1.0, A, n, x, 1, 1.0, r, 1);
-
-    cblas_dcopy(n, r, 1, p, 1);
-
-    double old_residual, residual;
-    old_residual = cblas_ddot(n, r, 1, r, 1);
+    cg_setup(&cg, A, b, x, n);
 
     nrmb_send_progress(1.0);
 
-    for (int iter = 0; iter <= n && iter <= maxiter; iter++)
+    for (int iter = 0; iter <= n && iter <= maxiter &&
+         !nrmb_run_expired(iter); iter++)
     {
-        cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, 1.0, A, n, p, 1, 0.0, Ap, 1);
+        nrm_time_t iter_start, iter_end;
+        nrm_time_gettime(&iter_start);
 
-        double alpha = old_residual / cblas_ddot(n, p, 1, Ap, 1);
-
-#pragma omp parallel for
-        for (int j = 0; j < n; j++)
-        {
-            x[j] = x[j] + alpha * p[j];
-            r[j] = r[j] - alpha * Ap[j];
-        }
+        cg_step(&cg);
 
-        residual = cblas_ddot(n, r, 1, r, 1);
-
-#pragma omp parallel for
-        for (int j = 0; j < n; j++)
-        {
-            p[j] = r[j] + (residual / old_residual) * p[j];
-        }
-
-        old_residual = residual;
         if (LOG)
         {
-            printf("Step: %d Error: %.11lf\n", iter, sqrt(old_residual));
+            printf("Step: %d Error: %.11lf\n", iter, sqrt(cg.old_residual));
         }
 		total_iterations = iter;
 	nrmb_send_progress(1.0);
+        nrm_time_gettime(&iter_end);
+        nrmb_hist_record(&iter_hist, nrm_time_diff(&iter_start, &iter_end));
     }
 
-    free(r);
-    free(p);
-    free(Ap);
+    cg_release(&cg);
 	
 	printf("CG total iterations: %d\n", total_iterations);
 }
@@ -93,13 +70,14 @@ int main(int argc, char *argv[])
     int n = atoi(argv[1]);
     char *conditionning = argv[2];
     LOG = atoi(argv[3]);
-    int maxiter = atoi(argv[4]);
+    long int maxiter = nrmb_parse_times(argv[4]);
 
-    A = (double *)malloc(n * n * sizeof(double));
-    b = (double *)malloc(n * sizeof(double));
-    x = (double *)malloc(n * sizeof(double));
+    A = (double *)nrmb_alloc(n * n * sizeof(double));
+    b = (double *)nrmb_alloc(n * sizeof(double));
+    x = (double *)nrmb_alloc(n * sizeof(double));
 
     nrmb_init(argv[0]);
+    nrmb_hist_init(&iter_hist);
     nrmb_send_progress(1.0);
 
     if (strcmp(conditionning, "good") == 0)
@@ -128,10 +106,25 @@ int main(int argc, char *argv[])
     time = (finish.tv_sec - start.tv_sec);
     time += (finish.tv_usec - start.tv_usec)/1e6;
 	printf("CG time: %f\n", time);
-
-	free(A);
-    free(b);
-    free(x);
+	nrmb_hist_print(stdout, "CG iteration", &iter_hist);
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, CG solver");
+	nrmb_report_config_int(report, "n", n);
+	nrmb_report_config_string(report, "conditioning", conditionning);
+	if (!nrmb_run_duration())
+		nrmb_report_config_int(report, "maxiter", maxiter);
+	nrmb_report_config_int(report, "threads", omp_get_max_threads());
+	nrmb_report_kernel(report, "CG iteration", &iter_hist, 0.0);
+	nrmb_report_metric(report, "time", time);
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(stdout, report, "A", A);
+	nrmb_report_finalize(report);
+
+	nrmb_free(A);
+    nrmb_free(b);
+    nrmb_free(x);
 
     return 0;
 }
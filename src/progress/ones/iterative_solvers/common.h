@@ -59,3 +59,69 @@ void initialize_symmetric_positive_poor_conditioning(double *A, double *b, doubl
         x[i] = 0.0;
     }
 }
+
+/* CG solve advanced one iteration at a time, so that other drivers can
+ * interleave CG iterations with their own work.
+ */
+struct cg_state
+{
+    int n;
+    double *A, *b, *x;
+    double *r, *p, *Ap;
+    double old_residual;
+};
+
+void cg_setup(struct cg_state *s, double *A, double *b, double *x, int n)
+{
+    s->n = n;
+    s->A = A;
+    s->b = b;
+    s->x = x;
+    s->r = (double *)nrmb_alloc(n * sizeof(double));
+    s->p = (double *)nrmb_alloc(n * sizeof(double));
+    s->Ap = (double *)nrmb_alloc(n * sizeof(double));
+
+    cblas_dcopy(n, b, 1, s->r, 1);
+    cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, -1.0, A, n, x, 1, 1.0, s->r, 1);
+
+    cblas_dcopy(n, s->r, 1, s->p, 1);
+
+    s->old_residual = cblas_ddot(n, s->r, 1, s->r, 1);
+}
+
+/* one CG iteration, returns the squared norm of the new residual */
+double cg_step(struct cg_state *s)
+{
+    int n = s->n;
+    double *x = s->x, *r = s->r, *p = s->p, *Ap = s->Ap;
+    double residual;
+
+    cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, 1.0, s->A, n, p, 1, 0.0, Ap, 1);
+
+    double alpha = s->old_residual / cblas_ddot(n, p, 1, Ap, 1);
+
+#pragma omp parallel for
+    for (int j = 0; j < n; j++)
+    {
+        x[j] = x[j] + alpha * p[j];
+        r[j] = r[j] - alpha * Ap[j];
+    }
+
+    residual = cblas_ddot(n, r, 1, r, 1);
+
+#pragma omp parallel for
+    for (int j = 0; j < n; j++)
+    {
+        p[j] = r[j] + (residual / s->old_residual) * p[j];
+    }
+
+    s->old_residual = residual;
+    return residual;
+}
+
+void cg_release(struct cg_state *s)
+{
+    nrmb_free(s->r);
+    nrmb_free(s->p);
+    nrmb_free(s->Ap);
+}
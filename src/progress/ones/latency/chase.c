@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+/* Pointer chasing: each thread owns a linked list laid out as a random cyclic
+ * permutation of cache lines, so that every load depends on the previous one
+ * and neither the prefetchers nor out-of-order execution can hide its
+ * latency. Independent chains walk the same list from evenly spaced starting
+ * points, each adding one more load in flight.
+ */
+#define CHASE_LINE 64
+#define CHASE_MAX_CHAINS 32
+
+struct chase_node {
+	struct chase_node *next;
+	char pad[CHASE_LINE - sizeof(struct chase_node *)];
+};
+
+static struct chase_node *nodes;
+
+/* link the len nodes of list into a single cycle in random order, and return
+ * the order, which the chains use to find their starting points.
+ */
+static size_t *chase_build(struct chase_node *list, size_t len, uint64_t seed)
+{
+	size_t *order = malloc(len * sizeof(size_t));
+	assert(order != NULL);
+
+	for (size_t i = 0; i < len; i++)
+		order[i] = i;
+	for (size_t i = len - 1; i > 0; i--) {
+		size_t j = nrmb_rand(&seed) % (i + 1);
+		size_t t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+	for (size_t i = 0; i < len; i++)
+		list[order[i]].next = &list[order[(i + 1) % len]];
+	return order;
+}
+
+/* hops dependent loads on each of chains chains, walked from locals: with a
+ * constant number of chains the inner loop unrolls and the chains live in
+ * registers, so that no store and reload sits on their dependency paths.
+ * chase_block specializes up to 16 chains, about as many as there are
+ * registers to hold them, larger counts walk the same loop from the stack.
+ */
+static inline __attribute__((always_inline))
+void chase_hops(struct chase_node **p, int chains, size_t hops)
+{
+	struct chase_node *q[CHASE_MAX_CHAINS];
+
+	for (int c = 0; c < chains; c++)
+		q[c] = p[c];
+	for (size_t k = 0; k < hops; k++) {
+#pragma GCC unroll 16
+		for (int c = 0; c < chains; c++)
+			q[c] = q[c]->next;
+	}
+	for (int c = 0; c < chains; c++)
+		p[c] = q[c];
+}
+
+#define CHASE_CASE(n) case n: chase_hops(p, n, hops); break
+
+static void chase_block(struct chase_node **p, int chains, size_t hops)
+{
+	switch (chains) {
+	CHASE_CASE(1); CHASE_CASE(2); CHASE_CASE(3); CHASE_CASE(4);
+	CHASE_CASE(5); CHASE_CASE(6); CHASE_CASE(7); CHASE_CASE(8);
+	CHASE_CASE(9); CHASE_CASE(10); CHASE_CASE(11); CHASE_CASE(12);
+	CHASE_CASE(13); CHASE_CASE(14); CHASE_CASE(15); CHASE_CASE(16);
+	default:
+		chase_hops(p, chains, hops);
+		break;
+	}
+}
+
+/* hops dependent loads on each chain, reporting progress every block hops */
+static void chase(struct chase_node **p, int chains, size_t hops,
+		  size_t block, double progress)
+{
+	for (size_t h = 0; h < hops; h += block) {
+		size_t stop = NRMB_MIN(h + block, hops);
+		chase_block(p, chains, stop - h);
+		nrmb_send_progress(progress * (stop - h) / hops);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - working set per thread, in bytes, rounded down to a whole number of
+	 *   cache lines per chain
+	 * - number of times to run through the list
+	 * - optionally, the number of independent chains per thread
+	 * - optionally, the number of hops between two progress reports,
+	 *   defaults to once per pass
+	 */
+	size_t working_set;
+	long int times;
+	int chains = 1;
+	size_t block = 0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist hist, passes;
+	struct nrmb_thread_hist threads;
+	nrm_time_t start, end;
+	size_t len, hops;
+	size_t **order;
+	struct chase_node ***pos;
+	int num_threads;
+
+	assert(argc >= 3 && argc <= 5);
+	errno = 0;
+	working_set = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+	if (argc >= 4) {
+		chains = strtol(argv[3], NULL, 0);
+		assert(!errno && chains > 0 && chains <= CHASE_MAX_CHAINS);
+	}
+	if (argc == 5) {
+		block = strtoull(argv[4], NULL, 0);
+		assert(!errno && block > 0);
+	}
+
+	/* each chain walks len/chains nodes per pass */
+	hops = working_set / CHASE_LINE / chains;
+	assert(hops > 0);
+	len = hops * chains;
+	if (block == 0)
+		block = hops;
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* allocate one list per thread, next to each other, and build each
+	 * one from its own thread so that first-touch keeps it local.
+	 */
+	nrmb_numa_init();
+	nodes = nrmb_alloc(num_threads * len * sizeof(struct chase_node));
+	order = calloc(num_threads, sizeof(size_t *));
+	pos = calloc(num_threads, sizeof(struct chase_node **));
+	assert(order != NULL && pos != NULL);
+
+#pragma omp parallel
+	{
+		int tid = omp_get_thread_num();
+		struct chase_node *list = &nodes[tid * len];
+
+		order[tid] = chase_build(list, len, 0x5eed + tid);
+		pos[tid] = malloc(chains * sizeof(struct chase_node *));
+		assert(pos[tid] != NULL);
+		for (int c = 0; c < chains; c++)
+			pos[tid][c] = &list[order[tid][c * hops]];
+	}
+
+	/* NRM Context init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the caches and TLBs */
+#pragma omp parallel
+	chase(pos[omp_get_thread_num()], chains, hops, hops, 0.0);
+
+	/* this version of the benchmarks reports one progress each time all
+	 * threads went through their list, in blocks of hops.
+	 */
+	nrmb_send_progress(1.0);
+
+	nrmb_hist_init(&hist);
+	nrmb_thread_hist_init(&threads, num_threads);
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+		nrm_time_gettime(&start);
+
+		/* the actual benchmark */
+#pragma omp parallel
+		{
+			int tid = omp_get_thread_num();
+			nrm_time_t tstart, tend;
+			nrm_time_gettime(&tstart);
+			chase(pos[tid], chains, hops, block, 1.0 / num_threads);
+			nrm_time_gettime(&tend);
+			nrmb_thread_hist_record(&threads, tid,
+						nrm_time_diff(&tstart, &tend));
+		}
+		nrm_time_gettime(&end);
+
+		time = nrm_time_diff(&start, &end);
+		nrmb_hist_record(&hist, time);
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings: each chain does hops
+	 * dependent loads per pass, so a pass takes hops load latencies. Use
+	 * the passes as timed by each thread, for the fork and join of the
+	 * parallel region not to count in small working sets.
+	 */
+	nrmb_hist_init(&passes);
+	for (int t = 0; t < num_threads; t++)
+		nrmb_hist_merge(&passes, &threads.hist[t]);
+
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, pointer-chasing latency benchmark\n");
+	fprintf(stdout, "Working set:         %.1f KiB per thread.\n",
+		(double) len * CHASE_LINE / 1024.0);
+	fprintf(stdout, "Chains per thread:   %d\n", chains);
+	fprintf(stdout, "Progress block:      %zu (hops).\n", block);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	fprintf(stdout, "Time (s): avg:       %11.6f min:  %11.6f max: %11.6f\n",
+		1.0E-09 * nrmb_hist_mean(&hist), 1.0E-09 * hist.min,
+		1.0E-09 * hist.max);
+	nrmb_hist_print(stdout, NULL, &hist);
+	nrmb_thread_hist_print(stdout, NULL, &threads);
+	fprintf(stdout, "Latency (ns/load): avg: %9.3f best: %9.3f\n",
+		nrmb_hist_mean(&passes) / hops, (double)passes.min / hops);
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, pointer-chasing latency benchmark");
+	nrmb_report_config_int(report, "working_set", len * CHASE_LINE);
+	nrmb_report_config_int(report, "chains", chains);
+	nrmb_report_config_int(report, "progress_block", block);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_kernel(report, "Chase", &hist, 0.0);
+	nrmb_report_threads(report, "Chase", &threads);
+	nrmb_report_metric(report, "latency_avg",
+			   nrmb_hist_mean(&passes) / hops);
+	nrmb_report_metric(report, "latency_best", (double)passes.min / hops);
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(stdout, report, "nodes", nodes);
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		fprintf(stdout, "NUMA placement:      %s\n", nrmb_numa_spec());
+		nrmb_report_config_string(report, "numa", nrmb_numa_spec());
+		nrmb_report_metric(report, "placement_ok",
+				   nrmb_numa_check(stdout, "nodes", nodes,
+						   num_threads * len,
+						   sizeof(struct chase_node)));
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: after the warm-up and times passes, chain c
+	 * went hops nodes further down the order for each pass.
+	 */
+	err = 0;
+	for (int t = 0; t < num_threads && err == 0; t++) {
+		struct chase_node *list = &nodes[t * len];
+		for (int c = 0; c < chains; c++) {
+			size_t i = ((c + times + 1) % chains) * hops;
+			err = err || pos[t][c] != &list[order[t][i]];
+		}
+	}
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -15,86 +15,7 @@
 #include <nrm.h>
 #include <math.h>
 
-#define MK 16
-#define NK (1 << MK)
-#define NQ 10
-
-/* utils functions */
-double randlc (double *, double);
-void vranlc (int, double *, double, double []);
-
-static double x[2*NK];
-#pragma omp threadprivate(x)
-static double q[NQ];
-
-void ep_kernel(double *gc, double *rx, double *ry, double a, double s, double an, size_t nn)
-{
-	int k_offset = -1;
-	double sx = 0.0, sy = 0.0;
-
-#pragma omp parallel copyin(x)
-	{
-		double t1, t2, t3, t4, x1, x2;
-		int k, kk, i, ik, l;
-		double qq[NQ];		/* private copy of q[0:NQ-1] */
-
-		for (i = 0; i < NQ; i++) qq[i] = 0.0;
-
-#pragma omp for reduction(+:sx,sy) schedule(static)  
-		for (k = 1; k <= (int)nn; k++) {
-			kk = k_offset + k;
-			t1 = s;
-			t2 = an;
-
-			/*      Find starting seed t1 for this kk. */
-
-			for (i = 1; i <= 100; i++) {
-				ik = kk / 2;
-				if (2 * ik != kk) t3 = randlc(&t1, t2);
-				if (ik == 0) break;
-				t3 = randlc(&t2, t2);
-				kk = ik;
-			}
-
-			/*      Compute uniform pseudorandom numbers. */
-
-			vranlc(2*NK, &t1, a, x);
-
-			/*
-			   c       Compute Gaussian deviates by acceptance-rejection method and 
-			   c       tally counts in concentric square annuli.  This loop is not 
-			   c       vectorizable.
-			   */
-
-			for ( i = 0; i < NK; i++) {
-				x1 = 2.0 * x[2*i] - 1.0;
-				x2 = 2.0 * x[2*i+1] - 1.0;
-				t1 = pow(x1,2) + pow(x2,2);
-				if (t1 <= 1.0) {
-					t2 = sqrt(-2.0 * log(t1) / t1);
-					t3 = fabs(x1 * t2);				/* Xi */
-					t4 = fabs(x2 * t2);				/* Yi */
-					l = fmax(t3, t4);
-					qq[l] += 1.0;				/* counts */
-					sx = sx + t3;				/* sum of Xi */
-					sy = sy + t4;				/* sum of Yi */
-				}
-			}
-		}
-#pragma omp critical
-		{
-			for (i = 0; i < NQ; i++) q[i] += qq[i];
-		}
-	}
-	for(size_t i = 0; i < NQ; i++)
-		*gc = *gc + q[i];
-	*rx = sx;
-	*ry = sy;
-}
-
-
-
-
+#include "npb.h"
 
 int main(int argc, char **argv)
 {
@@ -108,11 +29,12 @@ int main(int argc, char **argv)
 	size_t m;
 	size_t mm, nn;
 	double a = 1220703125.0, s = 271828183.0;
-	double t, an, gc, rx, ry;
+	double an, gc, rx, ry;
 	long int times;
 
 	/* needed for performance measurement */
-	int64_t sumtime = 0, mintime = INT64_MAX, maxtime = 0;
+	struct nrmb_hist hist;
+	struct nrmb_thread_hist threads;
 	nrm_time_t start, end;
 	int num_threads;
 
@@ -123,9 +45,7 @@ int main(int argc, char **argv)
 	errno = 0;
 	m = strtoull(argv[1], NULL, 0);
 	assert(!errno);
-	errno = 0;
-	times = strtol(argv[2], NULL, 0);
-	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
 
 	mm = m - MK;
 	nn = 1 << mm;
@@ -141,32 +61,8 @@ int main(int argc, char **argv)
 	assert(num_threads == err);
 	err = 0;
 
-	/* initialization: random number generator and private array
-	 * dum arrays are there to avoid dead code elimination
-	 */
-	double dum[3] = { 1.0, 1.0, 1.0 };
-	vranlc(0, &(dum[0]), dum[1], &(dum[2]));
-	dum[0] = randlc(&(dum[1]), dum[2]);
-    
-#pragma omp parallel for default(shared)
-	for (size_t i = 0; i < 2*NK; i++) x[i] = -1.0e99;
-
-	/* the original NAS EP considers this section part of the benchmark, but
-	 * it's single threaded, so we execute it as part of init to make the
-	 * whole benchmark even more parallel.
-	 */
-	vranlc(0, &t, a, x);
-
-	/* Compute AN = A ^ (2 * NK) (mod 2^46). */
-	t = a;
-	for (size_t i = 0; i <= MK; i++) {
-		randlc(&t, t);
-	}
-
-	for (size_t i = 0; i < NQ; i++) {
-		q[i] = 0.0;
-	}
-	an = t;
+	/* initialization: random number generator and private array */
+	an = ep_setup(a);
 	gc = 0.0;
 
 	/* NRM Context init */
@@ -176,7 +72,9 @@ int main(int argc, char **argv)
 	 * through the entire array.
 	 */
 	
-    for(long int iter = 0; iter < times; iter++)
+	nrmb_hist_init(&hist);
+	nrmb_thread_hist_init(&threads, num_threads);
+    for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
 	{
 		int64_t time;
 		nrm_time_gettime(&start);
@@ -184,15 +82,13 @@ int main(int argc, char **argv)
 		/* the actual benchmark is quite involved,
 		 * so we put it in a separate function
 		 */
-		ep_kernel(&gc, &rx, &ry, a, s, an, nn);
+		ep_kernel(&gc, &rx, &ry, a, s, an, nn, &threads);
 		nrm_time_gettime(&end);
         
 		nrmb_send_progress(1.0);
 
 		time = nrm_time_diff(&start, &end);
-		sumtime += time;
-		mintime = NRMB_MIN(time, mintime);
-		maxtime = NRMB_MAX(time, maxtime);
+		nrmb_hist_record(&hist, time);
 	}
 
 	nrmb_finalize();
@@ -208,7 +104,22 @@ int main(int argc, char **argv)
 	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
 	fprintf(stdout, "Number of threads:   %d\n", num_threads);
 	fprintf(stdout, "Time (s): avg:       %11.6f min:  %11.6f max: %11.6f\n",
-		1.0E-09 * sumtime/times, 1.0E-09 * mintime, 1.0E-09 * maxtime);
+		1.0E-09 * nrmb_hist_mean(&hist), 1.0E-09 * hist.min,
+		1.0E-09 * hist.max);
+	nrmb_hist_print(stdout, NULL, &hist);
+	nrmb_thread_hist_print(stdout, NULL, &threads);
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, NPB EP benchmark");
+	nrmb_report_config_int(report, "problem_size", m);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_kernel(report, "EP", &hist, 0.0);
+	nrmb_report_threads(report, "EP", &threads);
+	nrmb_report_metric(report, "gaussian_pairs", gc);
+	nrmb_report_metric(report, "sx", rx);
+	nrmb_report_metric(report, "sy", ry);
 
 #ifdef ENABLE_POST_VALIDATION
 	/* validate the benchmark: minimum about of bits should be different.
@@ -253,9 +164,12 @@ int main(int argc, char **argv)
 		fprintf(stdout, "VALIDATION FAILED!!!!\n");
 	else
 		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
 	return err;
 #else
 	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
 	return 0;
 #endif
 }
@@ -0,0 +1,129 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <math.h>
+
+#include "npb.h"
+
+/* NPB EP batches, shared by ones-npb-ep and the phase schedule driver */
+static double x[2*NK];
+#pragma omp threadprivate(x)
+static double q[NQ];
+
+double ep_setup(double a)
+{
+	double t;
+
+	/* initialization: random number generator and private array
+	 * dum arrays are there to avoid dead code elimination
+	 */
+	double dum[3] = { 1.0, 1.0, 1.0 };
+	vranlc(0, &(dum[0]), dum[1], &(dum[2]));
+	dum[0] = randlc(&(dum[1]), dum[2]);
+
+#pragma omp parallel for default(shared)
+	for (size_t i = 0; i < 2*NK; i++) x[i] = -1.0e99;
+
+	/* the original NAS EP considers this section part of the benchmark, but
+	 * it's single threaded, so we execute it as part of init to make the
+	 * whole benchmark even more parallel.
+	 */
+	vranlc(0, &t, a, x);
+
+	/* Compute AN = A ^ (2 * NK) (mod 2^46). */
+	t = a;
+	for (size_t i = 0; i <= MK; i++) {
+		randlc(&t, t);
+	}
+
+	for (size_t i = 0; i < NQ; i++) {
+		q[i] = 0.0;
+	}
+	return t;
+}
+
+void ep_kernel(double *gc, double *rx, double *ry, double a, double s, double an, size_t nn,
+	       struct nrmb_thread_hist *threads)
+{
+	int k_offset = -1;
+	double sx = 0.0, sy = 0.0;
+
+#pragma omp parallel copyin(x)
+	{
+		double t1, t2, t3, t4, x1, x2;
+		int k, kk, i, ik, l;
+		double qq[NQ];		/* private copy of q[0:NQ-1] */
+		nrm_time_t tstart, tend;
+
+		for (i = 0; i < NQ; i++) qq[i] = 0.0;
+
+		/* each thread times its own share of the pairs, the reduction
+		 * completes at the barrier ending the region.
+		 */
+		nrm_time_gettime(&tstart);
+#pragma omp for reduction(+:sx,sy) schedule(static) nowait
+		for (k = 1; k <= (int)nn; k++) {
+			kk = k_offset + k;
+			t1 = s;
+			t2 = an;
+
+			/*      Find starting seed t1 for this kk. */
+
+			for (i = 1; i <= 100; i++) {
+				ik = kk / 2;
+				if (2 * ik != kk) t3 = randlc(&t1, t2);
+				if (ik == 0) break;
+				t3 = randlc(&t2, t2);
+				kk = ik;
+			}
+
+			/*      Compute uniform pseudorandom numbers. */
+
+			vranlc(2*NK, &t1, a, x);
+
+			/*
+			   c       Compute Gaussian deviates by acceptance-rejection method and 
+			   c       tally counts in concentric square annuli.  This loop is not 
+			   c       vectorizable.
+			   */
+
+			for ( i = 0; i < NK; i++) {
+				x1 = 2.0 * x[2*i] - 1.0;
+				x2 = 2.0 * x[2*i+1] - 1.0;
+				t1 = pow(x1,2) + pow(x2,2);
+				if (t1 <= 1.0) {
+					t2 = sqrt(-2.0 * log(t1) / t1);
+					t3 = fabs(x1 * t2);				/* Xi */
+					t4 = fabs(x2 * t2);				/* Yi */
+					l = fmax(t3, t4);
+					qq[l] += 1.0;				/* counts */
+					sx = sx + t3;				/* sum of Xi */
+					sy = sy + t4;				/* sum of Yi */
+				}
+			}
+		}
+		nrm_time_gettime(&tend);
+		nrmb_thread_hist_record(threads, omp_get_thread_num(),
+					nrm_time_diff(&tstart, &tend));
+#pragma omp critical
+		{
+			for (i = 0; i < NQ; i++) q[i] += qq[i];
+		}
+	}
+	for(size_t i = 0; i < NQ; i++)
+		*gc = *gc + q[i];
+	*rx = sx;
+	*ry = sy;
+}
@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <math.h>
+#include <nrm.h>
+
+#include "npb.h"
+
+/* NPB IS ranking, shared by ones-npb-is and the phase schedule driver */
+int *key_array, *key_buff1, *key_buff2;
+
+/* bucket pointers are per thread, indexed by thread number rather than
+ * threadprivate, so that teams of any size up to the one given to is_setup
+ * can run the kernel.
+ */
+static int **bucket_size, **thread_bucket_ptrs;
+static int MAX_THREADS;
+
+static int TOTAL_KEYS;
+static int TOTAL_KS1;
+static int TOTAL_KS2;
+static int MAX_KEY_LOG_2;
+static int MAX_KEY;
+static int NUM_BUCKETS_LOG_2 = 10;
+static int NUM_BUCKETS;
+static int NUM_KEYS;
+static int SIZE_OF_BUFFERS;
+
+/*****************************************************************/
+/************   F  I  N  D  _  M  Y  _  S  E  E  D    ************/
+/************                                         ************/
+/************ returns parallel random number seq seed ************/
+/*****************************************************************/
+
+/*
+ * Create a random number sequence of total length nn residing
+ * on np number of processors.  Each processor will therefore have a
+ * subsequence of length nn/np.  This routine returns that random
+ * number which is the first random number for the subsequence belonging
+ * to processor rank kn, and which is used as seed for proc kn ran # gen.
+ */
+
+double find_my_seed(int kn,   /* my processor rank, 0<=kn<=num procs */
+                    int np,   /* np = num procs                      */
+                    long nn,  /* total num of ran numbers, all procs */
+                    double s, /* Ran num seed, for ex.: 314159265.00 */
+                    double a) /* Ran num gen mult, try 1220703125.00 */
+{
+
+  double t1, t2;
+  long mq, nq, kk, ik;
+
+  if (kn == 0)
+    return s;
+
+  mq = (nn / 4 + np - 1) / np;
+  nq = mq * 4 * kn; /* number of rans to be skipped */
+
+  t1 = s;
+  t2 = a;
+  kk = nq;
+  while (kk > 1) {
+    ik = kk / 2;
+    if (2 * ik == kk) {
+      (void)randlc(&t2, t2);
+      kk = ik;
+    } else {
+      (void)randlc(&t1, t2);
+      kk = kk - 1;
+    }
+  }
+  (void)randlc(&t1, t2);
+
+  return (t1);
+}
+
+/*****************************************************************/
+/*************      C  R  E  A  T  E  _  S  E  Q      ************/
+/*****************************************************************/
+
+void create_seq(double seed, double a) {
+  double x, s;
+  int i, k;
+
+#pragma omp parallel private(x, s, i, k)
+  {
+    int k1, k2;
+    double an = a;
+    int myid = 0, num_threads = 1;
+    int mq;
+
+#ifdef _OPENMP
+    myid = omp_get_thread_num();
+    num_threads = omp_get_num_threads();
+#endif
+
+    mq = (NUM_KEYS + num_threads - 1) / num_threads;
+    k1 = mq * myid;
+    k2 = k1 + mq;
+    if (k2 > NUM_KEYS)
+      k2 = NUM_KEYS;
+
+    s = find_my_seed(myid, num_threads, (long)4 * NUM_KEYS, seed, an);
+
+    k = MAX_KEY / 4;
+
+    for (i = k1; i < k2; i++) {
+      x = randlc(&s, an);
+      x += randlc(&s, an);
+      x += randlc(&s, an);
+      x += randlc(&s, an);
+
+      key_array[i] = k * x;
+    }
+  } /*omp parallel*/
+}
+
+void is_setup(size_t T, int max_threads) {
+  size_t total_keys_log_2 = T;
+
+  /* we don't support the type switching required to make class D & E work
+   */
+  assert(T < 27);
+
+  TOTAL_KEYS = (1L << total_keys_log_2);
+  TOTAL_KS1 = TOTAL_KEYS;
+  TOTAL_KS2 = 1;
+  MAX_KEY_LOG_2 = T - 4;
+  MAX_KEY = (1 << MAX_KEY_LOG_2);
+  NUM_BUCKETS = (1 << NUM_BUCKETS_LOG_2);
+  NUM_KEYS = TOTAL_KEYS;
+  SIZE_OF_BUFFERS = NUM_KEYS;
+  MAX_THREADS = max_threads;
+
+  bucket_size = (int **)calloc(sizeof(int *), max_threads);
+  thread_bucket_ptrs = (int **)calloc(sizeof(int *), max_threads);
+  assert(bucket_size != NULL && thread_bucket_ptrs != NULL);
+  for (int i = 0; i < max_threads; i++) {
+    bucket_size[i] = (int *)calloc(sizeof(int), NUM_BUCKETS);
+    thread_bucket_ptrs[i] = (int *)calloc(sizeof(int), NUM_BUCKETS);
+    assert(bucket_size[i] != NULL && thread_bucket_ptrs[i] != NULL);
+  }
+
+  key_array = (int *)nrmb_calloc(SIZE_OF_BUFFERS, sizeof(int));
+  key_buff1 = (int *)nrmb_calloc(MAX_KEY, sizeof(int));
+  key_buff2 = (int *)nrmb_calloc(SIZE_OF_BUFFERS, sizeof(int));
+
+#pragma omp parallel for
+  for (int i = 0; i < NUM_KEYS; i++)
+    key_buff2[i] = 0;
+
+  /*  Generate random number sequence and subsequent keys on all procs */
+  create_seq(314159265.00,   /* Random number gen seed */
+             1220703125.00); /* Random number gen mult */
+}
+
+/*****************************************************************/
+/*************             R  A  N  K             ****************/
+/*****************************************************************/
+
+void is_kernel(int iteration, int64_t *rank_time) {
+
+  int i, k;
+  int *key_buff_ptr, *key_buff_ptr2;
+
+  int shift = MAX_KEY_LOG_2 - NUM_BUCKETS_LOG_2;
+  int num_bucket_keys = (1L << shift);
+
+  key_array[iteration] = iteration;
+  key_array[iteration + MAX_ITERATIONS] = MAX_KEY - iteration;
+
+  /*  Setup pointers to key buffers  */
+  key_buff_ptr2 = key_buff2;
+  key_buff_ptr = key_buff1;
+
+#pragma omp parallel private(i, k)
+  {
+    int *work_buff, *bucket_ptrs, m, k1, k2;
+    int myid = 0, num_threads = 1;
+    nrm_time_t rank_start, rank_end;
+
+    myid = omp_get_thread_num();
+    num_threads = omp_get_num_threads();
+    assert(num_threads <= MAX_THREADS);
+
+    /*  Bucket sort is known to improve cache performance on some   */
+    /*  cache based systems.  But the actual performance may depend */
+    /*  on cache size, problem size. */
+
+    work_buff = bucket_size[myid];
+    bucket_ptrs = thread_bucket_ptrs[myid];
+
+    /*  Initialize */
+    for (i = 0; i < NUM_BUCKETS; i++)
+      work_buff[i] = 0;
+
+      /*  Determine the number of keys in each bucket */
+#pragma omp for schedule(static)
+    for (i = 0; i < NUM_KEYS; i++)
+      work_buff[key_array[i] >> shift]++;
+
+    /*  Accumulative bucket sizes are the bucket pointers.
+        These are global sizes accumulated upon to each bucket */
+    bucket_ptrs[0] = 0;
+    for (k = 0; k < myid; k++)
+      bucket_ptrs[0] += bucket_size[k][0];
+
+    for (i = 1; i < NUM_BUCKETS; i++) {
+      bucket_ptrs[i] = bucket_ptrs[i - 1];
+      for (k = 0; k < myid; k++)
+        bucket_ptrs[i] += bucket_size[k][i];
+      for (k = myid; k < num_threads; k++)
+        bucket_ptrs[i] += bucket_size[k][i - 1];
+    }
+
+    /*  Sort into appropriate bucket */
+#pragma omp for schedule(static)
+    for (i = 0; i < NUM_KEYS; i++) {
+      k = key_array[i];
+      key_buff2[bucket_ptrs[k >> shift]++] = k;
+    }
+
+    /*  The bucket pointers now point to the final accumulated sizes */
+    if (myid < num_threads - 1) {
+      for (i = 0; i < NUM_BUCKETS; i++)
+        for (k = myid + 1; k < num_threads; k++)
+          bucket_ptrs[i] += bucket_size[k][i];
+    }
+
+    /*  Now, buckets are sorted.  We only need to sort keys inside
+        each bucket, which can be done in parallel.  Because the distribution
+        of the number of keys in the buckets is Gaussian, the use of
+        a dynamic schedule should improve load balance, thus, performance     */
+
+    /*  Each thread times its own share of the ranking, without waiting for
+        the others: the end of the parallel region is the barrier. */
+    nrm_time_gettime(&rank_start);
+#pragma omp for schedule(dynamic) nowait
+    for (i = 0; i < NUM_BUCKETS; i++) {
+
+      /*  Clear the work array section associated with each bucket */
+      k1 = i * num_bucket_keys;
+      k2 = k1 + num_bucket_keys;
+      for (k = k1; k < k2; k++)
+        key_buff_ptr[k] = 0;
+
+      /*  Ranking of all keys occurs in this section:                 */
+
+      /*  In this section, the keys themselves are used as their
+          own indexes to determine how many of each there are: their
+          individual population                                       */
+      m = (i > 0) ? bucket_ptrs[i - 1] : 0;
+      for (k = m; k < bucket_ptrs[i]; k++)
+        key_buff_ptr[key_buff_ptr2[k]]++; /* Now they have individual key   */
+                                          /* population                     */
+
+      /*  To obtain ranks of each key, successively add the individual key
+          population, not forgetting to add m, the total of lesser keys,
+          to the first key population */
+      key_buff_ptr[k1] += m;
+      for (k = k1 + 1; k < k2; k++)
+        key_buff_ptr[k] += key_buff_ptr[k - 1];
+    }
+    nrm_time_gettime(&rank_end);
+    rank_time[myid] += nrm_time_diff(&rank_start, &rank_end);
+
+  } /*omp parallel*/
+}
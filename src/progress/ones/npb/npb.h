@@ -0,0 +1,44 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#ifndef NRMB_NPB_H
+#define NRMB_NPB_H 1
+
+/* NAS random number generator, see randdp.c */
+double randlc(double *, double);
+void vranlc(int, double *, double, double []);
+
+/* EP: each batch generates 2^MK pairs of uniform deviates, so a problem of
+ * size M runs 2^(M-MK) batches. ep_setup initializes the generator and
+ * returns the multiplier for the start of each batch. ep_kernel adds its
+ * counts and sums to gc, rx and ry, each thread timing its share in threads.
+ */
+#define MK 16
+#define NK (1 << MK)
+#define NQ 10
+
+double ep_setup(double a);
+void ep_kernel(double *gc, double *rx, double *ry, double a, double s,
+	       double an, size_t nn, struct nrmb_thread_hist *threads);
+
+/* IS: is_setup allocates the keys and buffers for a problem of size T
+ * (2^T keys) and teams of up to max_threads threads, then generates the
+ * keys. Each is_kernel call ranks all keys once, for iterations in
+ * [0, MAX_ITERATIONS), and adds the time each thread spent ranking its
+ * buckets to rank_time.
+ */
+#define MAX_ITERATIONS 10
+
+extern int *key_array, *key_buff1, *key_buff2;
+
+void is_setup(size_t T, int max_threads);
+void is_kernel(int iteration, int64_t *rank_time);
+
+#endif
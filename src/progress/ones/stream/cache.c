@@ -0,0 +1,455 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <sched.h>
+#include <string.h>
+
+#include "common.h"
+
+/* Stream sized per cache level: each data or unified cache level the threads
+ * run on, as described in /sys/devices/system/cpu/cpuN/cache, gets its own
+ * phase, with arrays sized so that the share of each thread fits in its share
+ * of that cache. A last phase, DRAM, works on four times the total of the last
+ * level caches the threads run on. Threads are bound to one CPU each of the
+ * process affinity mask, so that the caches they read are those they use.
+ */
+#define CACHE_MAX_LEVELS 4
+#define CACHE_MAX_CPUS 1024
+#define CACHE_SYSFS "/sys/devices/system/cpu/cpu%d/cache/index%d/%s"
+
+static const char *level_names[CACHE_MAX_LEVELS + 1] = {
+	"L1", "L2", "L3", "L4", "DRAM"
+};
+
+struct level {
+	const char *name;
+	size_t share;
+	size_t array_size;
+	long int reps;
+	long int count;
+	long int passes;
+	double *a, *b, *c;
+	struct nrmb_hist hist[4];
+	struct nrmb_thread_hist threads[4];
+};
+
+static int cache_read(int cpu, int index, const char *file, char *buf,
+		      size_t len)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), CACHE_SYSFS, cpu, index, file);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return -1;
+	if (fgets(buf, len, f) == NULL) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/* number of CPUs in a list like 0-3,8-11 */
+static int cache_count_cpus(const char *list)
+{
+	int count = 0;
+	while (*list != '\0') {
+		char *p;
+		long first = strtol(list, &p, 10), last = first;
+		if (*p == '-')
+			last = strtol(p + 1, &p, 10);
+		count += last - first + 1;
+		if (*p != ',')
+			break;
+		list = p + 1;
+	}
+	return NRMB_MAX(count, 1);
+}
+
+/* size in bytes of each data or unified cache level of cpu, as a whole and
+ * divided among the CPUs sharing it, and the list of these CPUs, which
+ * identifies the cache instance. Levels the CPU does not have are left at
+ * zero.
+ */
+static void cache_levels(int cpu, size_t *size, size_t *share,
+			 char cpus[][256])
+{
+	char buf[256];
+
+	for (int i = 0; cache_read(cpu, i, "level", buf, sizeof(buf)) == 0;
+	     i++) {
+		int level = strtol(buf, NULL, 10);
+		size_t bytes;
+		char *unit;
+
+		if (level < 1 || level > CACHE_MAX_LEVELS)
+			continue;
+		if (cache_read(cpu, i, "type", buf, sizeof(buf)) ||
+		    !strcmp(buf, "Instruction"))
+			continue;
+		if (cache_read(cpu, i, "size", buf, sizeof(buf)))
+			continue;
+		bytes = strtoull(buf, &unit, 10);
+		if (*unit == 'K')
+			bytes <<= 10;
+		else if (*unit == 'M')
+			bytes <<= 20;
+		else if (*unit == 'G')
+			bytes <<= 30;
+		size[level-1] = bytes;
+		share[level-1] = bytes;
+		snprintf(cpus[level-1], 256, "%d", cpu);
+		if (cache_read(cpu, i, "shared_cpu_list", buf, sizeof(buf)) == 0) {
+			share[level-1] = bytes / cache_count_cpus(buf);
+			snprintf(cpus[level-1], 256, "%s", buf);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - number of times to run through the benchmark at each level
+	 * - optionally, the fraction of its share of each cache that the
+	 *   arrays of a thread fill, defaults to 0.5
+	 */
+	long int times;
+	double fraction = 0.5;
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	struct level levels[CACHE_MAX_LEVELS + 1];
+	size_t share[CACHE_MAX_LEVELS];
+	size_t llc_size = 0, num_levels = 0;
+	int llc_level = 0, num_llcs = 0, num_cpus = 0;
+	int cpus[CACHE_MAX_CPUS];
+	char (*llcs)[256];
+	cpu_set_t set;
+	const char *names[4] = {"Copy", "Scale", "Add", "Triad"};
+	stream_kernel_t kernels[4] = {stream_copy, stream_scale, stream_add,
+				      stream_triad};
+	size_t bytes[4] = {2, 2, 3, 3};
+	const struct stream_simd *simd;
+	nrm_time_t start, end;
+	char key[64];
+	int num_threads;
+
+	assert(argc == 2 || argc == 3);
+	times = nrmb_parse_times(argv[1]);
+	if (argc == 3) {
+		fraction = strtod(argv[2], NULL);
+		assert(fraction > 0.0 && fraction <= 1.0);
+	}
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	simd = stream_simd_select();
+	if (simd != NULL) {
+		kernels[0] = simd->copy;
+		kernels[1] = simd->scale;
+		kernels[2] = simd->add;
+		kernels[3] = simd->triad;
+	}
+
+	/* bind each thread to its own CPU of the affinity mask, wrapping
+	 * around when there are more threads than CPUs.
+	 */
+	sched_getaffinity(0, sizeof(set), &set);
+	for (int c = 0; c < CPU_SETSIZE && num_cpus < CACHE_MAX_CPUS; c++)
+		if (CPU_ISSET(c, &set))
+			cpus[num_cpus++] = c;
+	assert(num_cpus > 0);
+#pragma omp parallel
+	{
+		cpu_set_t mine;
+		CPU_ZERO(&mine);
+		CPU_SET(cpus[omp_get_thread_num() % num_cpus], &mine);
+		if (sched_setaffinity(0, sizeof(mine), &mine))
+			perror("sched_setaffinity");
+	}
+
+	/* each thread looks at the caches of its CPU, and a level gets the
+	 * smallest share over all threads, so that it fits on every kind of
+	 * core. A level missing on one CPU is dropped. The last level caches
+	 * are counted once per instance, told apart by the CPUs sharing them.
+	 */
+	for (int l = 0; l < CACHE_MAX_LEVELS; l++)
+		share[l] = SIZE_MAX;
+	llcs = calloc(num_threads, sizeof(*llcs));
+	assert(llcs != NULL);
+#pragma omp parallel
+	{
+		size_t tsize[CACHE_MAX_LEVELS] = {0};
+		size_t tshare[CACHE_MAX_LEVELS] = {0};
+		char tcpus[CACHE_MAX_LEVELS][256];
+
+		cache_levels(cpus[omp_get_thread_num() % num_cpus], tsize,
+			     tshare, tcpus);
+#pragma omp critical
+		for (int l = 0; l < CACHE_MAX_LEVELS; l++) {
+			int seen = 0;
+
+			share[l] = NRMB_MIN(share[l], tshare[l]);
+			if (tsize[l] == 0 || l + 1 < llc_level)
+				continue;
+			if (l + 1 > llc_level) {
+				llc_level = l + 1;
+				llc_size = 0;
+				num_llcs = 0;
+			}
+			for (int i = 0; i < num_llcs && !seen; i++)
+				seen = !strcmp(llcs[i], tcpus[l]);
+			if (!seen) {
+				snprintf(llcs[num_llcs++], 256, "%s", tcpus[l]);
+				llc_size += tsize[l];
+			}
+		}
+	}
+	free(llcs);
+
+	/* threads that share a CPU also share its part of each cache */
+	for (int l = 0; l < CACHE_MAX_LEVELS; l++)
+		share[l] /= (num_threads + num_cpus - 1) / num_cpus;
+	if (llc_size == 0)
+		fprintf(stderr, "cache: no cache description in sysfs\n");
+	assert(llc_size > 0);
+
+	/* the arrays of a thread fill fraction of its share of a cache, in
+	 * whole cache lines. Each level gets its own arrays, initialized by the
+	 * threads that use them, or placed as NRMB_NUMA asks.
+	 */
+	nrmb_numa_init();
+	for (int l = 0; l <= CACHE_MAX_LEVELS; l++) {
+		struct level *lv = &levels[num_levels];
+		size_t per_thread;
+
+		lv->name = level_names[l];
+		if (l < CACHE_MAX_LEVELS) {
+			if (share[l] == 0)
+				continue;
+			lv->share = share[l];
+			per_thread = fraction * share[l] / (3 * sizeof(double));
+		} else {
+			lv->share = 4 * llc_size / num_threads;
+			per_thread = lv->share / (3 * sizeof(double));
+		}
+		per_thread = NRMB_MAX(per_thread & ~(size_t)7, 8);
+		lv->array_size = per_thread * num_threads;
+		lv->a = nrmb_alloc(lv->array_size * sizeof(double));
+		lv->b = nrmb_alloc(lv->array_size * sizeof(double));
+		lv->c = nrmb_alloc(lv->array_size * sizeof(double));
+		assert(lv->a != NULL && lv->b != NULL && lv->c != NULL);
+		num_levels++;
+	}
+
+	/* small arrays are run over several times in a row, so that every
+	 * level moves about as much memory as DRAM and the timer resolution
+	 * does not get in the way.
+	 */
+	for (size_t l = 0; l < num_levels; l++) {
+		struct level *lv = &levels[l];
+		lv->reps = NRMB_MAX(levels[num_levels-1].array_size /
+				    lv->array_size, 1);
+#pragma omp parallel
+		{
+			size_t start, end;
+			nrmb_static_range(lv->array_size, &start, &end);
+			for(size_t i = start; i < end; i++)
+			{
+				lv->a[i] = 1.0;
+				lv->b[i] = 2.0;
+				lv->c[i] = 0.0;
+			}
+		}
+	}
+
+	/* NRM init */
+	nrmb_init(argv[0]);
+
+	/* this version of the benchmarks reports one progress per iteration
+	 * at each level, levels running one after the other.
+	 */
+	long int runs = times;
+	for (size_t l = 0; l < num_levels; l++) {
+		struct level *lv = &levels[l];
+		double *a = lv->a, *b = lv->b, *c = lv->c;
+		size_t array_size = lv->array_size;
+		long int reps = lv->reps;
+
+		/* one run for free to bring the arrays into the cache.
+		 * Repeating a kernel does not change the arrays, so each
+		 * iteration below counts as a single pass for validation.
+		 */
+		stream_repeat(stream_copy, c, a, NULL, 0.0, array_size, 1,
+			      NULL);
+		stream_repeat(stream_scale, b, c, NULL, scalar, array_size, 1,
+			      NULL);
+		stream_repeat(stream_add, c, a, b, 0.0, array_size, 1,
+			      NULL);
+		stream_repeat(stream_triad, a, b, c, scalar, array_size, 1,
+			      NULL);
+		nrmb_send_progress(1.0);
+		lv->passes = 1;
+
+		for(size_t k = 0; k < 4; k++) {
+			nrmb_hist_init(&lv->hist[k]);
+			nrmb_thread_hist_init(&lv->threads[k], num_threads);
+		}
+
+		lv->count = times;
+		for(long int iter = 0; nrmb_run_next(iter, &lv->count); iter++)
+		{
+			int64_t time;
+
+			stream_cycle_reset(a, b, c, array_size, &lv->passes);
+			lv->passes++;
+
+#define TSTART(k) nrm_time_gettime(&start)
+#define TEND(i) do { \
+		nrm_time_gettime(&end); \
+		time = nrm_time_diff(&start, &end); \
+		nrmb_hist_record(&lv->hist[i], time / reps); \
+	} while(0)
+
+			TSTART(0);
+			stream_repeat(kernels[0], c, a, NULL, 0.0, array_size, reps,
+				      &lv->threads[0]);
+			TEND(0);
+			TSTART(1);
+			stream_repeat(kernels[1], b, c, NULL, scalar, array_size, reps,
+				      &lv->threads[1]);
+			TEND(1);
+			TSTART(2);
+			stream_repeat(kernels[2], c, a, b, 0.0, array_size, reps,
+				      &lv->threads[2]);
+			TEND(2);
+			TSTART(3);
+			stream_repeat(kernels[3], a, b, c, scalar, array_size, reps,
+				      &lv->threads[3]);
+			TEND(3);
+
+			nrmb_send_progress(1.0);
+		}
+		runs = NRMB_MIN(runs, lv->count);
+	}
+	times = runs;
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, Stream per cache level\n");
+	fprintf(stdout, "Cache fraction:      %.2f\n", fraction);
+	fprintf(stdout, "Kernel was executed: %ld times per level.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	fprintf(stdout, "Last level cache:    L%d, %.1f MiB in %d instances.\n",
+		llc_level, (double)llc_size/1024.0/1024.0, num_llcs);
+	if (simd)
+		fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Stream per cache level");
+	nrmb_report_config_double(report, "fraction", fraction);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_config_int(report, "llc_size", llc_size);
+	nrmb_report_config_int(report, "llc_instances", num_llcs);
+	nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+
+	/* one line per level, best bandwidth of each kernel and the worst
+	 * imbalance among them, the structured report has the full statistics.
+	 */
+	fprintf(stdout, "%6s %14s %12s", "Level", "Share (KiB)", "Elements");
+	for(size_t k = 0; k < 4; k++)
+		fprintf(stdout, " %14s", names[k]);
+	fprintf(stdout, " %10s   (best MiB/s)\n", "Imbalance");
+	for (size_t l = 0; l < num_levels; l++) {
+		struct level *lv = &levels[l];
+		size_t level_size = lv->array_size * sizeof(double);
+
+		fprintf(stdout, "%6s %14.1f %12zu", lv->name,
+			(double)lv->share/1024.0, lv->array_size);
+		snprintf(key, sizeof(key), "%s_share", lv->name);
+		nrmb_report_config_int(report, key, lv->share);
+		snprintf(key, sizeof(key), "%s_array_size", lv->name);
+		nrmb_report_config_int(report, key, lv->array_size);
+		double worst = 0.0;
+		for(size_t k = 0; k < 4; k++) {
+			struct nrmb_hist *h = &lv->hist[k];
+			double tmin, tavg, tmax, imbalance;
+			fprintf(stdout, " %14.1f",
+				(bytes[k] * 1.0E-06 * level_size)/ (1.0E-09 * h->min));
+			nrmb_thread_hist_stats(&lv->threads[k], &tmin, &tavg,
+					       &tmax, &imbalance);
+			worst = NRMB_MAX(worst, imbalance);
+			snprintf(key, sizeof(key), "%s %s", names[k], lv->name);
+			nrmb_report_kernel(report, key, h,
+					   (double)bytes[k] * level_size);
+			nrmb_report_threads(report, key, &lv->threads[k]);
+		}
+		fprintf(stdout, " %10.3f\n", worst);
+	}
+
+	/* pages and placement of the DRAM arrays, the others fit in caches */
+	struct level *dram = &levels[num_levels-1];
+	stream_alloc_report(stdout, report, dram->a, dram->b, dram->c);
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT)
+		stream_numa_placement(stdout, report, dram->array_size,
+				      dram->a, dram->b, dram->c);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
+	err = 0;
+	for (size_t l = 0; l < num_levels && err == 0; l++) {
+		struct level *lv = &levels[l];
+		double ai, bi, ci;
+		stream_cycle_replay(scalar, lv->passes, &ai, &bi, &ci);
+		err = err || !nrmb_check_array(ai, lv->a, lv->array_size, 2);
+		err = err || !nrmb_check_array(bi, lv->b, lv->array_size, 2);
+		err = err || !nrmb_check_array(ci, lv->c, lv->array_size, 2);
+	}
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+/* STREAM kernels over a range of the arrays, with a common signature so that
+ * drivers can walk the arrays in blocks:
+ * - copy:  dst = x
+ * - scale: dst = scalar*x
+ * - add:   dst = x + y
+ * - triad: dst = x + scalar*y
+ * - fill:  dst = scalar, for write-only traffic
+ */
+typedef void (*stream_kernel_t)(double *dst, const double *x, const double *y,
+				double scalar, size_t start, size_t end);
+
+/* hand-vectorized versions of the kernels, see simd.c */
+struct stream_simd {
+	const char *name;
+	stream_kernel_t copy, scale, add, triad, fill;
+};
+
+/* kernels selected by NRMB_SIMD (auto, sse2, avx2 or avx512, with a -nt
+ * suffix for non-temporal stores), NULL to keep the compiler-generated loops.
+ */
+const struct stream_simd *stream_simd_select(void);
+
+static inline void stream_copy(double *dst, const double *x, const double *y,
+			       double scalar, size_t start, size_t end)
+{
+	(void)y;
+	(void)scalar;
+	for (size_t i = start; i < end; i++)
+		dst[i] = x[i];
+}
+
+static inline void stream_scale(double *dst, const double *x, const double *y,
+				double scalar, size_t start, size_t end)
+{
+	(void)y;
+	for (size_t i = start; i < end; i++)
+		dst[i] = scalar*x[i];
+}
+
+static inline void stream_add(double *dst, const double *x, const double *y,
+			      double scalar, size_t start, size_t end)
+{
+	(void)scalar;
+	for (size_t i = start; i < end; i++)
+		dst[i] = x[i] + y[i];
+}
+
+static inline void stream_triad(double *dst, const double *x, const double *y,
+				double scalar, size_t start, size_t end)
+{
+	for (size_t i = start; i < end; i++)
+		dst[i] = x[i] + scalar*y[i];
+}
+
+static inline void stream_fill(double *dst, const double *x, const double *y,
+			       double scalar, size_t start, size_t end)
+{
+	(void)x;
+	(void)y;
+	for (size_t i = start; i < end; i++)
+		dst[i] = scalar;
+}
+
+/* run a kernel over the whole array, with each thread walking its
+ * schedule(static) share in blocks of block_size elements and reporting
+ * progress from inside the parallel region after each block. The work split
+ * is the same as a parallel for, so first-touch placement is preserved, and a
+ * full pass over the array reports a total of progress. Each thread records
+ * the time of its share in threads.
+ */
+static inline void stream_blocked(stream_kernel_t kernel, double *dst,
+				  const double *x, const double *y,
+				  double scalar, size_t array_size,
+				  size_t block_size, double progress,
+				  struct nrmb_thread_hist *threads)
+{
+#pragma omp parallel
+	{
+		size_t start, end;
+		nrm_time_t tstart, tend;
+		nrm_time_gettime(&tstart);
+		nrmb_static_range(array_size, &start, &end);
+		for (size_t k = start; k < end; k += block_size) {
+			size_t stop = NRMB_MIN(k + block_size, end);
+			kernel(dst, x, y, scalar, k, stop);
+			nrmb_send_progress(progress * (stop - k) / array_size);
+		}
+		nrm_time_gettime(&tend);
+		nrmb_thread_hist_record(threads, omp_get_thread_num(),
+					nrm_time_diff(&tstart, &tend));
+	}
+}
+
+/* parallel for over the whole array, each thread recording the time of its
+ * share in threads. The loop has no barrier of its own, so that a thread stops
+ * its clock as soon as it is done, the end of the region still joins them.
+ */
+#define STREAM_TIMED_FOR(threads, array_size, body) \
+	_Pragma("omp parallel") \
+	{ \
+		nrm_time_t tstart_, tend_; \
+		nrm_time_gettime(&tstart_); \
+		_Pragma("omp for nowait") \
+		for (size_t i = 0; i < (array_size); i++) \
+			body; \
+		nrm_time_gettime(&tend_); \
+		nrmb_thread_hist_record((threads), omp_get_thread_num(), \
+					nrm_time_diff(&tstart_, &tend_)); \
+	}
+
+/* run a kernel reps times over the whole array inside a single parallel
+ * region, each thread repeating its schedule(static) share without
+ * synchronizing with the others. Threads never read what another thread
+ * wrote, so this is valid, and it keeps the fork/join cost out of the
+ * measurement when the array is small enough for a pass to be cheaper than a
+ * parallel region. Unless threads is NULL, each thread records the time of
+ * one pass over its share, averaged over the reps.
+ */
+static inline void stream_repeat(stream_kernel_t kernel, double *dst,
+				 const double *x, const double *y,
+				 double scalar, size_t array_size, long int reps,
+				 struct nrmb_thread_hist *threads)
+{
+#pragma omp parallel
+	{
+		size_t start, end;
+		nrm_time_t tstart, tend;
+		nrm_time_gettime(&tstart);
+		nrmb_static_range(array_size, &start, &end);
+		for (long int r = 0; r < reps; r++)
+			kernel(dst, x, y, scalar, start, end);
+		nrm_time_gettime(&tend);
+		if (threads != NULL)
+			nrmb_thread_hist_record(threads, omp_get_thread_num(),
+						nrm_time_diff(&tstart, &tend) /
+						NRMB_MAX(reps, 1));
+	}
+}
+
+/* a pass of the full cycle (copy, scale, add, triad) multiplies the values by
+ * about 15, so doubles overflow after about 260 of them, and validation could
+ * only compare infinities. Long runs put the arrays back to their initial
+ * values, outside of the timings, once passes reaches STREAM_CYCLE_PASSES, and
+ * validation replays the passes since the last reset.
+ */
+#define STREAM_CYCLE_PASSES 128
+
+static inline void stream_cycle_reset(double *a, double *b, double *c,
+				      size_t array_size, long int *passes)
+{
+	if (*passes < STREAM_CYCLE_PASSES)
+		return;
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+	*passes = 0;
+}
+
+static inline void stream_cycle_replay(double scalar, long int passes,
+				       double *ai, double *bi, double *ci)
+{
+	*ai = 1.0;
+	*bi = 2.0;
+	*ci = 0.0;
+	for(long int i = 0; i < passes; i++) {
+		*ci = *ai;
+		*bi = scalar * *ci;
+		*ci = *ai + *bi;
+		*ai = *bi + scalar * *ci;
+	}
+}
+
+/* per NUMA node breakdown of a kernel: runs it times more over the array,
+ * each thread timing its own share, and groups threads by the node they run
+ * on and the node holding their share of dst. A group bandwidth is its part of
+ * the traffic over the time of its slowest thread. The kernel must leave the
+ * arrays unchanged when repeated, so that post validation still holds.
+ */
+static inline void stream_numa_report(FILE *out, struct nrmb_report *report,
+				      const char *name, stream_kernel_t kernel,
+				      double *dst, const double *x,
+				      const double *y, double scalar,
+				      size_t array_size, size_t bytes,
+				      long int times)
+{
+	int num_nodes = nrmb_numa_num_nodes();
+	int num_threads = omp_get_max_threads();
+	size_t num_groups = num_nodes * num_nodes;
+	int64_t *time = calloc(num_threads, sizeof(int64_t));
+	int *group = calloc(num_threads, sizeof(int));
+	size_t *elems = calloc(num_threads, sizeof(size_t));
+	int64_t *group_time = calloc(num_groups, sizeof(int64_t));
+	size_t *group_elems = calloc(num_groups, sizeof(size_t));
+	int *group_threads = calloc(num_groups, sizeof(int));
+	struct nrmb_hist *hist = malloc(num_groups * sizeof(struct nrmb_hist));
+	char key[64];
+
+	assert(time != NULL && group != NULL && elems != NULL);
+	assert(group_time != NULL && group_elems != NULL);
+	assert(group_threads != NULL && hist != NULL);
+	for (size_t g = 0; g < num_groups; g++)
+		nrmb_hist_init(&hist[g]);
+
+	for (long int iter = 0; iter < times; iter++) {
+#pragma omp parallel
+		{
+			int tid = omp_get_thread_num();
+			size_t start, end;
+			nrm_time_t tstart, tend;
+
+			nrmb_static_range(array_size, &start, &end);
+			nrm_time_gettime(&tstart);
+			kernel(dst, x, y, scalar, start, end);
+			nrm_time_gettime(&tend);
+			time[tid] = nrm_time_diff(&tstart, &tend);
+			if (iter == 0) {
+				int cpu = nrmb_numa_thread_node();
+				int mem = -1;
+				if (end > start)
+					mem = nrmb_numa_node_of(&dst[(start + end)/2]);
+				group[tid] = (cpu < 0 || mem < 0) ? -1 :
+					cpu * num_nodes + mem;
+				elems[tid] = end - start;
+			}
+		}
+
+		for (size_t g = 0; g < num_groups; g++)
+			group_time[g] = 0;
+		for (int t = 0; t < num_threads; t++) {
+			if (group[t] < 0)
+				continue;
+			group_time[group[t]] = NRMB_MAX(group_time[group[t]],
+							time[t]);
+			if (iter == 0) {
+				group_elems[group[t]] += elems[t];
+				group_threads[group[t]]++;
+			}
+		}
+		for (size_t g = 0; g < num_groups; g++)
+			if (group_threads[g])
+				nrmb_hist_record(&hist[g], group_time[g]);
+	}
+
+	for (size_t g = 0; g < num_groups; g++) {
+		double traffic = (double)bytes * sizeof(double) * group_elems[g];
+		if (!group_threads[g])
+			continue;
+		fprintf(out, "%s node %zu -> %zu: threads: %3d Perf (MiB/s): avg: %12.6f best: %12.6f\n",
+			name, g / num_nodes, g % num_nodes, group_threads[g],
+			(1.0E-06 * traffic) / (1.0E-09 * nrmb_hist_mean(&hist[g])),
+			(1.0E-06 * traffic) / (1.0E-09 * hist[g].min));
+		snprintf(key, sizeof(key), "%s node %zu->%zu", name,
+			 g / num_nodes, g % num_nodes);
+		nrmb_report_kernel(report, key, &hist[g], traffic);
+	}
+
+	free(time);
+	free(group);
+	free(elems);
+	free(group_time);
+	free(group_elems);
+	free(group_threads);
+	free(hist);
+}
+
+/* report the NUMA placement in use and check where the arrays ended up, c
+ * can be NULL for two-array kernels.
+ */
+static inline void stream_numa_placement(FILE *out, struct nrmb_report *report,
+					 size_t array_size, const double *a,
+					 const double *b, const double *c)
+{
+	int ok = 1;
+
+	fprintf(out, "NUMA placement:      %s\n", nrmb_numa_spec());
+	nrmb_report_config_string(report, "numa", nrmb_numa_spec());
+	ok = nrmb_numa_check(out, "a", a, array_size, sizeof(double)) && ok;
+	ok = nrmb_numa_check(out, "b", b, array_size, sizeof(double)) && ok;
+	if (c != NULL)
+		ok = nrmb_numa_check(out, "c", c, array_size, sizeof(double)) && ok;
+	nrmb_report_metric(report, "placement_ok", ok);
+}
+
+/* report the pages backing the arrays, c can be NULL for two-array kernels */
+static inline void stream_alloc_report(FILE *out, struct nrmb_report *report,
+				       const double *a, const double *b,
+				       const double *c)
+{
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(out, report, "a", a);
+	nrmb_alloc_report(out, report, "b", b);
+	if (c != NULL)
+		nrmb_alloc_report(out, report, "c", c);
+}
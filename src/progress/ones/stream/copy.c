@@ -16,6 +16,8 @@
 #include <omp.h>
 #include <stddef.h>
 
+#include "common.h"
+
 static double *a, *b;
 
 int main(int argc, char **argv)
@@ -23,12 +25,18 @@ int main(int argc, char **argv)
     /* configuration parameters:
      * - array size in number of double elements
      * - number of times to run through the benchmark
+     * - optionally, a block size in number of elements: each thread then
+     *   reports progress after each block, from inside the parallel region
      */
     size_t array_size;
     long int times;
+    size_t block_size = 0;
+    const struct stream_simd *simd;
+    stream_kernel_t kernel = stream_copy;
 
     /* needed for performance measurement */
-    int64_t sumtime = 0, mintime = INT64_MAX, maxtime = 0;
+    struct nrmb_hist hist;
+    struct nrmb_thread_hist threads;
     nrm_time_t start, end;
     size_t memory_size;
     int num_threads;
@@ -36,13 +44,15 @@ int main(int argc, char **argv)
 	/* retrieve the size of the allocation and the number of time
 	 * to loop through the kernel.
 	 */
-	assert(argc == 3);
+	assert(argc == 3 || argc == 4);
 	errno = 0;
 	array_size = strtoull(argv[1], NULL, 0);
 	assert(!errno);
-	errno = 0;
-	times = strtol(argv[2], NULL, 0);
-	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+	if (argc == 4) {
+		block_size = strtoull(argv[3], NULL, 0);
+		assert(!errno && block_size > 0);
+	}
 
     /* ensure that OpenMP is giving us the right number of threads */
 #pragma omp parallel
@@ -55,13 +65,22 @@ int main(int argc, char **argv)
     assert(num_threads == err);
     err = 0;
 
+    /* explicit SIMD kernels go through the blocked driver, with a single
+     * block per thread unless a block size was given.
+     */
+    simd = stream_simd_select();
+    if (simd != NULL)
+        kernel = simd->copy;
+
     /* allocate the arrays and initialize them. Note that we expect the
      * first-touch policy of Linux to result in the arrays being properly
-     * balanced between threads/numa-nodes
+     * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+     * explicit placement.
      */
+    nrmb_numa_init();
     memory_size = array_size * sizeof(double);
-    a = malloc(memory_size);
-    b = malloc(memory_size);
+    a = nrmb_alloc(memory_size);
+    b = nrmb_alloc(memory_size);
 
 #pragma omp parallel for
     for(size_t i = 0; i < array_size; i++)
@@ -83,25 +102,27 @@ int main(int argc, char **argv)
      */
     nrmb_send_progress(1.0);
 
-    for(long int iter = 0; iter < times; iter++)
+    nrmb_hist_init(&hist);
+    nrmb_thread_hist_init(&threads, num_threads);
+    for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
     {
         int64_t time;
         nrm_time_gettime(&start);
 
         /* the actual benchmark */
-#pragma omp parallel for
-        for(size_t i = 0; i < array_size; i++)
-        {
-            b[i] = a[i];
-        }
+        if (block_size || simd) {
+            stream_blocked(kernel, b, a, NULL, 0.0, array_size,
+                           block_size ? block_size : array_size,
+                           1.0, &threads);
+        } else {
+        STREAM_TIMED_FOR(&threads, array_size, b[i] = a[i]);
         
 	nrmb_send_progress(1.0);
+        }
         nrm_time_gettime(&end);
 
         time = nrm_time_diff(&start, &end);
-        sumtime += time;
-        mintime = NRMB_MIN(time, mintime);
-        maxtime = NRMB_MAX(time, maxtime);
+        nrmb_hist_record(&hist, time);
     }
 
     nrmb_finalize();
@@ -116,27 +137,62 @@ int main(int argc, char **argv)
             (double) memory_size /1024.0/1024.0);
     fprintf(stdout, "Kernel was executed: %ld times.\n", times);
     fprintf(stdout, "Number of threads:   %d\n", num_threads);
+    if (block_size)
+        fprintf(stdout, "Progress block:      %zu (elements).\n", block_size);
+    if (simd)
+        fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
     fprintf(stdout, "Time (s): avg:       %11.6f min:  %11.6f max: %11.6f\n",
-            1.0E-09 * sumtime/times, 1.0E-09 * mintime, 1.0E-09 * maxtime);
+            1.0E-09 * nrmb_hist_mean(&hist), 1.0E-09 * hist.min,
+            1.0E-09 * hist.max);
+    nrmb_hist_print(stdout, NULL, &hist);
+    nrmb_thread_hist_print(stdout, NULL, &threads);
     fprintf(stdout, "Perf (MiB/s): avg:   %12.6f best: %12.6f\n",
-            (2.0E-06 * memory_size)/ (1.0E-09 * sumtime/times),
-            (2.0E-06 * memory_size)/ (1.0E-09 * mintime));
+            (2.0E-06 * memory_size)/ (1.0E-09 * nrmb_hist_mean(&hist)),
+            (2.0E-06 * memory_size)/ (1.0E-09 * hist.min));
+
+    /* structured version of the report */
+    struct nrmb_report *report = nrmb_report_create(argv[0],
+        "one progress per iteration, Copy benchmark");
+    nrmb_report_config_int(report, "array_size", array_size);
+    nrmb_report_config_int(report, "memory_per_array", memory_size);
+    nrmb_report_config_int(report, "times", times);
+    nrmb_report_config_int(report, "threads", num_threads);
+    nrmb_report_config_int(report, "block_size", block_size);
+    nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+    nrmb_report_kernel(report, "Copy", &hist, 2.0 * memory_size);
+    nrmb_report_threads(report, "Copy", &threads);
+
+    stream_alloc_report(stdout, report, a, b, NULL);
+
+    if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+        stream_numa_placement(stdout, report, array_size, b, a, NULL);
+        stream_numa_report(stdout, report, "Copy", kernel,
+                                   b, a, NULL, 0.0,
+                                   array_size, 2, times);
+    }
 
 #ifdef ENABLE_POST_VALIDATION
 	/* validate the benchmark: for a copy, the minimum about of bits should
 	 * be different.
 	 */
-	err = 0;
-	for(size_t i = 0; i < array_size && err == 0; i++)
-		err = err || !nrmb_check_double(a[i], b[i], 2);
+	nrm_time_gettime(&start);
+	err = !nrmb_check_arrays(a, b, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
 
 	if(err)
 		fprintf(stdout, "VALIDATION FAILED!!!!\n");
 	else
 		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
 	return err;
 #else
 	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
 	return 0;
 #endif
 }
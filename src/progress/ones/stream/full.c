@@ -14,6 +14,8 @@
 
 #include <nrm.h>
 
+#include "common.h"
+
 static double *a, *b, *c;
 
 int main(int argc, char **argv)
@@ -21,15 +23,20 @@ int main(int argc, char **argv)
 	/* configuration parameters:
 	 * - array size in number of double elements
 	 * - number of times to run through the benchmark
+	 * - optionally, a block size in number of elements: each thread then
+	 *   reports progress after each block, from inside the parallel region
 	 */
 	size_t array_size;
 	long int times;
+	size_t block_size = 0;
+	const struct stream_simd *simd;
+	stream_kernel_t kernels[4] = {stream_copy, stream_scale, stream_add,
+				      stream_triad};
 	double scalar = 3.0;
 
 	/* needed for performance measurement */
-	int64_t sumtime[4] = {0,0,0,0};
-	int64_t mintime[4] = {INT64_MAX, INT64_MAX, INT64_MAX, INT64_MAX};
-	int64_t maxtime[4] = {0, 0, 0, 0};
+	struct nrmb_hist hist[4];
+	struct nrmb_thread_hist threads[4];
 	const char *names[4] = {"Copy", "Scale", "Add", "Triad"};
 	size_t bytes[4] = {2, 2, 3, 3};
 	nrm_time_t progress_start, progress_end;
@@ -41,13 +48,15 @@ int main(int argc, char **argv)
 	/* retrieve the size of the allocation and the number of time
 	 * to loop through the kernel.
 	 */
-	assert(argc == 3);
+	assert(argc == 3 || argc == 4);
 	errno = 0;
 	array_size = strtoull(argv[1], NULL, 0);
 	assert(!errno);
-	errno = 0;
-	times = strtol(argv[2], NULL, 0);
-	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+	if (argc == 4) {
+		block_size = strtoull(argv[3], NULL, 0);
+		assert(!errno && block_size > 0);
+	}
 
 	/* ensure that OpenMP is giving us the right number of threads */
 #pragma omp parallel
@@ -60,14 +69,27 @@ int main(int argc, char **argv)
 	assert(num_threads == err);
 	err = 0;
 
+	/* explicit SIMD kernels go through the blocked driver, with a single
+	 * block per thread unless a block size was given.
+	 */
+	simd = stream_simd_select();
+	if (simd != NULL) {
+		kernels[0] = simd->copy;
+		kernels[1] = simd->scale;
+		kernels[2] = simd->add;
+		kernels[3] = simd->triad;
+	}
+
 	/* allocate the arrays and initialize them. Note that we expect the
 	 * first-touch policy of Linux to result in the arrays being properly
-	 * balanced between threads/numa-nodes
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
 	 */
+	nrmb_numa_init();
 	memory_size = array_size * sizeof(double);
-	a = malloc(memory_size);
-	b = malloc(memory_size);
-	c = malloc(memory_size);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
 
 #pragma omp parallel for
 	for(size_t i = 0; i < array_size; i++)
@@ -100,40 +122,63 @@ int main(int argc, char **argv)
 	 */
 
 	nrmb_send_progress(1.0);
+	long int passes = 1;
+
+	for(size_t i = 0; i < 4; i++) {
+		nrmb_hist_init(&hist[i]);
+		nrmb_thread_hist_init(&threads[i], num_threads);
+	}
 
-	for(long int iter = 0; iter < times; iter++)
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
 	{
 		int64_t time;
 
+		stream_cycle_reset(a, b, c, array_size, &passes);
+		passes++;
+
 #define TSTART(k) nrm_time_gettime(&start)
 #define TEND(i) do { \
 		nrm_time_gettime(&end); \
 		time = nrm_time_diff(&start, &end); \
-		sumtime[i] += time; \
-		mintime[i] = NRMB_MIN(time, mintime[i]); \
-		maxtime[i] = NRMB_MAX(time, maxtime[i]); \
+		nrmb_hist_record(&hist[i], time); \
 	} while(0)
 
+		/* the actual benchmarks, in blocks: each kernel reports a
+		 * quarter of the iteration progress.
+		 */
+		if (block_size || simd) {
+			size_t block = block_size ? block_size : array_size;
+			TSTART(0);
+			stream_blocked(kernels[0], c, a, NULL, 0.0,
+				       array_size, block, 0.25, &threads[0]);
+			TEND(0);
+			TSTART(1);
+			stream_blocked(kernels[1], b, c, NULL, scalar,
+				       array_size, block, 0.25, &threads[1]);
+			TEND(1);
+			TSTART(2);
+			stream_blocked(kernels[2], c, a, b, 0.0,
+				       array_size, block, 0.25, &threads[2]);
+			TEND(2);
+			TSTART(3);
+			stream_blocked(kernels[3], a, b, c, scalar,
+				       array_size, block, 0.25, &threads[3]);
+			TEND(3);
+			continue;
+		}
+
 		/* the actual benchmarks */
 		TSTART(0);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		c[i] = a[i];
+		STREAM_TIMED_FOR(&threads[0], array_size, c[i] = a[i]);
 		TEND(0);
 		TSTART(1);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		b[i] = scalar*c[i];
+		STREAM_TIMED_FOR(&threads[1], array_size, b[i] = scalar*c[i]);
 		TEND(1);
 		TSTART(2);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		c[i] = a[i] + b[i];
+		STREAM_TIMED_FOR(&threads[2], array_size, c[i] = a[i] + b[i]);
 		TEND(2);
 		TSTART(3);
-#pragma omp parallel for
-	for(size_t i = 0; i < array_size; i++)
-		a[i] = b[i] + scalar*c[i];
+		STREAM_TIMED_FOR(&threads[3], array_size, a[i] = b[i] + scalar*c[i]);
 		TEND(3);
 
 		nrmb_send_progress(1.0);
@@ -153,40 +198,73 @@ int main(int argc, char **argv)
 		(double) memory_size /1024.0/1024.0);
 	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
 	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	if (block_size)
+		fprintf(stdout, "Progress block:      %zu (elements).\n", block_size);
+	if (simd)
+		fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
 	fprintf(stdout, "Progress Time (ns):   %" PRId64 "\n", progress_time);
 
 	for(size_t i = 0; i < 4; i++) {
 	fprintf(stdout, "%s Time (s): avg: %11.6f min: %11.6f max: %11.6f\n",
-		names[i], 1.0E-09 * sumtime[i]/times, 1.0E-09 * mintime[i],
-		1.0E-09 * maxtime[i]);
+		names[i], 1.0E-09 * nrmb_hist_mean(&hist[i]),
+		1.0E-09 * hist[i].min, 1.0E-09 * hist[i].max);
+	nrmb_hist_print(stdout, names[i], &hist[i]);
+	nrmb_thread_hist_print(stdout, names[i], &threads[i]);
 	fprintf(stdout, "%s Perf (MiB/s): avg: %12.6f best: %12.6f\n", names[i],
-		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * sumtime[i]/times),
-		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * mintime[i]));
+		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * nrmb_hist_mean(&hist[i])),
+		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * hist[i].min));
+	}
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Stream benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "block_size", block_size);
+	nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_metric(report, "progress_time", 1.0E-09 * progress_time);
+	for(size_t i = 0; i < 4; i++) {
+		nrmb_report_kernel(report, names[i], &hist[i],
+				   (double)bytes[i] * memory_size);
+		nrmb_report_threads(report, names[i], &threads[i]);
+	}
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+		stream_numa_report(stdout, report, "Triad", kernels[3],
+				   a, b, c, scalar,
+				   array_size, 3, times);
 	}
 
 #ifdef ENABLE_POST_VALIDATION
 	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
 	err = 0;
-	double ai = 1.0, bi = 2.0, ci = 0.0;
-	for(long int i = 0; i < times+1; i++) {
-		ci = ai;
-		bi = scalar*ci;
-		ci = ai+bi;
-		ai = bi+scalar*ci;
-	}
-	for(size_t i = 0; i < array_size && err == 0; i++) {
-		err = err || !nrmb_check_double(ai, a[i], 2);
-		err = err || !nrmb_check_double(bi, b[i], 2);
-		err = err || !nrmb_check_double(ci, c[i], 2);
-	}
+	double ai, bi, ci;
+	stream_cycle_replay(scalar, passes, &ai, &bi, &ci);
+	err = err || !nrmb_check_array(ai, a, array_size, 2);
+	err = err || !nrmb_check_array(bi, b, array_size, 2);
+	err = err || !nrmb_check_array(ci, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
 
 	if(err)
 		fprintf(stdout, "VALIDATION FAILED!!!!\n");
 	else
 		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
 	return err;
 #else
 	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
 	return 0;
 #endif
 }
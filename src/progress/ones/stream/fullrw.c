@@ -0,0 +1,247 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+
+/* sum of the array, each thread timing its own share */
+static double stream_read(const double *x, size_t array_size,
+			  struct nrmb_thread_hist *threads)
+{
+	double sum = 0.0;
+
+#pragma omp parallel
+	{
+		nrm_time_t tstart, tend;
+		nrm_time_gettime(&tstart);
+#pragma omp for simd reduction(+:sum) nowait
+		for(size_t i = 0; i < array_size; i++)
+			sum += x[i];
+		nrm_time_gettime(&tend);
+		nrmb_thread_hist_record(threads, omp_get_thread_num(),
+					nrm_time_diff(&tstart, &tend));
+	}
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark
+	 */
+	size_t array_size;
+	long int times;
+	double scalar = 3.0;
+	double sum = 0.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist hist[6];
+	struct nrmb_thread_hist threads[6];
+	const char *names[6] = {"Copy", "Scale", "Add", "Triad", "Read",
+				"Write"};
+	size_t bytes[6] = {2, 2, 3, 3, 1, 1};
+	nrm_time_t start, end;
+	size_t memory_size;
+	int num_threads;
+
+	/* retrieve the size of the allocation and the number of time
+	 * to loop through the kernel.
+	 */
+	assert(argc == 3);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* allocate the arrays and initialize them. Note that we expect the
+	 * first-touch policy of Linux to result in the arrays being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* NRM init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[i];
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		b[i] = scalar*c[i];
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[i] + b[i];
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		a[i] = b[i] + scalar*c[i];
+#pragma omp parallel for reduction(+:sum)
+	for(size_t i = 0; i < array_size; i++)
+		sum += a[i];
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = scalar;
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array.
+	 */
+	nrmb_send_progress(1.0);
+	long int passes = 1;
+
+	for(size_t i = 0; i < 6; i++) {
+		nrmb_hist_init(&hist[i]);
+		nrmb_thread_hist_init(&threads[i], num_threads);
+	}
+
+	/* Read sums the result of Triad, Write fills c with the scalar, which
+	 * the next Copy overwrites.
+	 */
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+
+		stream_cycle_reset(a, b, c, array_size, &passes);
+		passes++;
+
+#define TSTART(k) nrm_time_gettime(&start)
+#define TEND(i) do { \
+		nrm_time_gettime(&end); \
+		time = nrm_time_diff(&start, &end); \
+		nrmb_hist_record(&hist[i], time); \
+	} while(0)
+
+		TSTART(0);
+		STREAM_TIMED_FOR(&threads[0], array_size, c[i] = a[i]);
+		TEND(0);
+		TSTART(1);
+		STREAM_TIMED_FOR(&threads[1], array_size, b[i] = scalar*c[i]);
+		TEND(1);
+		TSTART(2);
+		STREAM_TIMED_FOR(&threads[2], array_size, c[i] = a[i] + b[i]);
+		TEND(2);
+		TSTART(3);
+		STREAM_TIMED_FOR(&threads[3], array_size,
+				 a[i] = b[i] + scalar*c[i]);
+		TEND(3);
+		TSTART(4);
+		sum = stream_read(a, array_size, &threads[4]);
+		TEND(4);
+		TSTART(5);
+		STREAM_TIMED_FOR(&threads[5], array_size, c[i] = scalar);
+		TEND(5);
+
+		nrmb_send_progress(1.0);
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, Stream benchmark with read-only and write-only kernels\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+
+	for(size_t i = 0; i < 6; i++) {
+	fprintf(stdout, "%s Time (s): avg: %11.6f min: %11.6f max: %11.6f\n",
+		names[i], 1.0E-09 * nrmb_hist_mean(&hist[i]),
+		1.0E-09 * hist[i].min, 1.0E-09 * hist[i].max);
+	nrmb_hist_print(stdout, names[i], &hist[i]);
+	nrmb_thread_hist_print(stdout, names[i], &threads[i]);
+	fprintf(stdout, "%s Perf (MiB/s): avg: %12.6f best: %12.6f\n", names[i],
+		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * nrmb_hist_mean(&hist[i])),
+		(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * hist[i].min));
+	}
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Stream benchmark with read-only and write-only kernels");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	for(size_t i = 0; i < 6; i++) {
+		nrmb_report_kernel(report, names[i], &hist[i],
+				   (double)bytes[i] * memory_size);
+		nrmb_report_threads(report, names[i], &threads[i]);
+	}
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT)
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different.
+	 * All the values are integers, the sum is exact as long as it fits
+	 * in a double mantissa, and close enough otherwise.
+	 */
+	nrm_time_gettime(&start);
+	err = 0;
+	double ai, bi, ci;
+	stream_cycle_replay(scalar, passes, &ai, &bi, &ci);
+	err = err || !nrmb_check_double_prec(ai * array_size, sum, 1e-8);
+	err = err || !nrmb_check_array(ai, a, array_size, 2);
+	err = err || !nrmb_check_array(bi, b, array_size, 2);
+	err = err || !nrmb_check_array(scalar, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,331 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <string.h>
+#include <nrm.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+static uint32_t *idx;
+
+/* Indexed STREAM kernels, as found in unstructured mesh codes:
+ * - gather:       c[i] = a[idx[i]]
+ * - scatter:      c[idx[i]] = a[i]
+ * - gather triad: a[i] = b[idx[i]] + scalar*c[i]
+ * The index array is always a permutation, so that scatters never conflict,
+ * and its pattern decides how much of each cache line fetched is used:
+ * - identity:   idx[i] = i, the contiguous kernels plus the index traffic
+ * - stride:<N>: every N-th element, then the same shifted by one, and so on
+ * - block:<N>:  contiguous blocks of N elements, in random order
+ * - random:     a random permutation
+ */
+#define INDEXED_LINE 64
+
+static void indexed_shuffle(uint32_t *v, size_t n, uint64_t *seed)
+{
+	if (n < 2)
+		return;
+	for (size_t i = n - 1; i > 0; i--) {
+		size_t j = nrmb_rand(seed) % (i + 1);
+		uint32_t t = v[i];
+		v[i] = v[j];
+		v[j] = t;
+	}
+}
+
+static void indexed_build(const char *pattern, size_t n)
+{
+	uint64_t seed = 0x5eed;
+	size_t param, pos = 0;
+
+	if (!strcmp(pattern, "identity")) {
+		for (size_t i = 0; i < n; i++)
+			idx[i] = i;
+	}
+	else if (sscanf(pattern, "stride:%zu", &param) == 1 && param > 0) {
+		for (size_t j = 0; j < param; j++)
+			for (size_t k = j; k < n; k += param)
+				idx[pos++] = k;
+	}
+	else if (sscanf(pattern, "block:%zu", &param) == 1 && param > 0) {
+		size_t num_blocks = (n + param - 1) / param;
+		uint32_t *blocks = malloc(num_blocks * sizeof(uint32_t));
+		assert(blocks != NULL);
+		for (size_t k = 0; k < num_blocks; k++)
+			blocks[k] = k;
+		indexed_shuffle(blocks, num_blocks, &seed);
+		for (size_t k = 0; k < num_blocks; k++)
+			for (size_t i = blocks[k] * param;
+			     i < NRMB_MIN((blocks[k] + 1) * param, n); i++)
+				idx[pos++] = i;
+		free(blocks);
+	}
+	else if (!strcmp(pattern, "random")) {
+		for (size_t i = 0; i < n; i++)
+			idx[i] = i;
+		indexed_shuffle(idx, n, &seed);
+	}
+	else
+		assert(0 && "unknown index pattern");
+}
+
+/* cache lines of the indexed array fetched in one pass, assuming a line is
+ * only reused by consecutive accesses. That holds for working sets larger
+ * than the caches, the ones this benchmark is meant for.
+ */
+static size_t indexed_lines(size_t n)
+{
+	const size_t per_line = INDEXED_LINE / sizeof(double);
+	size_t lines = n > 0;
+
+	for (size_t i = 1; i < n; i++)
+		lines += idx[i] / per_line != idx[i - 1] / per_line;
+	return lines;
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark
+	 * - optionally, the index pattern: identity, stride:<N>, block:<N> or
+	 *   random (the default)
+	 */
+	size_t array_size;
+	long int times;
+	const char *pattern = "random";
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist hist[3];
+	struct nrmb_thread_hist threads[3];
+	const char *names[3] = {"Gather", "Scatter", "Gather Triad"};
+	size_t bytes[3] = {2, 2, 3};
+	double useful[3], effective[3];
+	nrm_time_t start, end;
+	size_t memory_size, lines;
+	int num_threads;
+
+	/* retrieve the size of the allocation and the number of time
+	 * to loop through the kernel.
+	 */
+	assert(argc == 3 || argc == 4);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	assert(array_size <= UINT32_MAX);
+	times = nrmb_parse_times(argv[2]);
+	if (argc == 4)
+		pattern = argv[3];
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* allocate the arrays and initialize them. Note that we expect the
+	 * first-touch policy of Linux to result in the arrays being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement. The index array is touched the same way before
+	 * the pattern is written into it.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+	idx = nrmb_alloc(array_size * sizeof(uint32_t));
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+		idx[i] = 0;
+	}
+	indexed_build(pattern, array_size);
+	lines = indexed_lines(array_size);
+
+	/* useful traffic is what the STREAM kernel reads and writes, effective
+	 * traffic adds the index array and the unused part of the cache lines
+	 * of the indexed array.
+	 */
+	for (size_t k = 0; k < 3; k++) {
+		useful[k] = (double)bytes[k] * memory_size;
+		effective[k] = (double)(bytes[k] - 1) * memory_size +
+			(double)array_size * sizeof(uint32_t) +
+			(double)lines * INDEXED_LINE;
+	}
+
+	/* NRM init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[idx[i]];
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[idx[i]] = a[i];
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		a[i] = b[idx[i]] + scalar*c[i];
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array.
+	 */
+	nrmb_send_progress(1.0);
+	long int passes = 1;
+
+	for(size_t i = 0; i < 3; i++) {
+		nrmb_hist_init(&hist[i]);
+		nrmb_thread_hist_init(&threads[i], num_threads);
+	}
+
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+
+		/* Triad triples a each pass, reset it as the full cycle */
+		stream_cycle_reset(a, b, c, array_size, &passes);
+		passes++;
+
+#define TSTART(k) nrm_time_gettime(&start)
+#define TEND(i) do { \
+		nrm_time_gettime(&end); \
+		time = nrm_time_diff(&start, &end); \
+		nrmb_hist_record(&hist[i], time); \
+	} while(0)
+
+		TSTART(0);
+		STREAM_TIMED_FOR(&threads[0], array_size, c[i] = a[idx[i]]);
+		TEND(0);
+		TSTART(1);
+		STREAM_TIMED_FOR(&threads[1], array_size, c[idx[i]] = a[i]);
+		TEND(1);
+		TSTART(2);
+		STREAM_TIMED_FOR(&threads[2], array_size,
+				 a[i] = b[idx[i]] + scalar*c[i]);
+		TEND(2);
+
+		nrmb_send_progress(1.0);
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, indexed Stream benchmark\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Index pattern:       %s\n", pattern);
+	fprintf(stdout, "Lines per element:   %.3f\n",
+		array_size ? (double)lines / array_size : 0.0);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+
+	for(size_t i = 0; i < 3; i++) {
+	fprintf(stdout, "%s Time (s): avg: %11.6f min: %11.6f max: %11.6f\n",
+		names[i], 1.0E-09 * nrmb_hist_mean(&hist[i]),
+		1.0E-09 * hist[i].min, 1.0E-09 * hist[i].max);
+	nrmb_hist_print(stdout, names[i], &hist[i]);
+	nrmb_thread_hist_print(stdout, names[i], &threads[i]);
+	fprintf(stdout, "%s Useful Perf (MiB/s): avg: %12.6f best: %12.6f\n",
+		names[i],
+		(1.0E-06 * useful[i])/ (1.0E-09 * nrmb_hist_mean(&hist[i])),
+		(1.0E-06 * useful[i])/ (1.0E-09 * hist[i].min));
+	fprintf(stdout, "%s Effective Perf (MiB/s): avg: %12.6f best: %12.6f\n",
+		names[i],
+		(1.0E-06 * effective[i])/ (1.0E-09 * nrmb_hist_mean(&hist[i])),
+		(1.0E-06 * effective[i])/ (1.0E-09 * hist[i].min));
+	}
+
+	/* structured version of the report: kernel bandwidth is the useful
+	 * one, the effective one is a metric.
+	 */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, indexed Stream benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_string(report, "pattern", pattern);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_metric(report, "lines_per_element",
+			   array_size ? (double)lines / array_size : 0.0);
+	for(size_t i = 0; i < 3; i++) {
+		char key[64];
+		nrmb_report_kernel(report, names[i], &hist[i], useful[i]);
+		nrmb_report_threads(report, names[i], &threads[i]);
+		snprintf(key, sizeof(key), "%s_effective_best", names[i]);
+		nrmb_report_metric(report, key,
+				   (1.0E-06 * effective[i])/ (1.0E-09 * hist[i].min));
+	}
+
+	stream_alloc_report(stdout, report, a, b, c);
+	nrmb_alloc_report(stdout, report, "idx", idx);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT)
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different.
+	 * The index array must be a permutation, the arrays then stay uniform
+	 * as they start.
+	 */
+	nrm_time_gettime(&start);
+	err = 0;
+	unsigned char *seen = calloc(array_size, 1);
+	assert(seen != NULL);
+#pragma omp parallel for reduction(||:err)
+	for(size_t i = 0; i < array_size; i++)
+		err = err || idx[i] >= array_size ||
+			__atomic_exchange_n(&seen[idx[i]], 1, __ATOMIC_RELAXED);
+	free(seen);
+	double ai = 1.0, bi = 2.0, ci = 0.0;
+	for(long int i = 0; i < passes; i++) {
+		ci = ai;
+		ai = bi+scalar*ci;
+	}
+	err = err || !nrmb_check_array(ai, a, array_size, 2);
+	err = err || !nrmb_check_array(bi, b, array_size, 2);
+	err = err || !nrmb_check_array(ci, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,309 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+
+/* Malleable Triad: the team size changes between iterations, either
+ * following a schedule of segments, or on SIGUSR1 (one more thread) and
+ * SIGUSR2 (one less). Each change starts a new segment, timed on its own, and
+ * the first iteration of a segment is kept apart so that the cost of the
+ * transition shows up next to the steady state.
+ */
+struct segment {
+	int threads;
+	const char *length;
+	long int count;
+	int64_t duration;
+	int64_t first;
+	int64_t wall;
+	struct nrmb_hist hist;
+	struct nrmb_thread_hist busy;
+};
+
+static int signal_delta;
+
+static void malleable_signal(int sig)
+{
+	__atomic_add_fetch(&signal_delta, sig == SIGUSR1 ? 1 : -1,
+			   __ATOMIC_RELAXED);
+}
+
+/* schedule: comma-separated threads:length segments, the length being a
+ * number of iterations or a duration, cycled over until the end of the run.
+ */
+static struct segment *schedule_parse(char *arg, int max_threads, size_t *num)
+{
+	struct segment *s = NULL;
+	char *save, *tok;
+	size_t n = 0;
+
+	for (tok = strtok_r(arg, ",", &save); tok != NULL;
+	     tok = strtok_r(NULL, ",", &save)) {
+		char *length = strchr(tok, ':');
+		assert(length != NULL);
+		*length++ = '\0';
+		s = realloc(s, (n + 1) * sizeof(struct segment));
+		assert(s != NULL);
+		errno = 0;
+		s[n].threads = strtol(tok, NULL, 0);
+		assert(!errno && s[n].threads > 0 &&
+		       s[n].threads <= max_threads);
+		s[n].length = length;
+		s[n].duration = nrmb_parse_duration(length);
+		s[n].count = s[n].duration > 0 ? LONG_MAX :
+			strtol(length, NULL, 0);
+		assert(!errno && s[n].count > 0);
+		n++;
+	}
+	assert(n > 0);
+	*num = n;
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark, over all segments
+	 * - optionally, a schedule of threads:length segments, otherwise the
+	 *   team size starts with all threads and follows SIGUSR1/SIGUSR2
+	 */
+	size_t array_size;
+	long int times;
+	struct segment *schedule = NULL, *segments = NULL;
+	size_t num_schedule = 0, num_segments = 0;
+	const struct stream_simd *simd;
+	stream_kernel_t kernel = stream_triad;
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	nrm_time_t start, end, seg_start;
+	size_t memory_size;
+	int max_threads;
+	char key[128];
+
+	assert(argc == 3 || argc == 4);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+
+	/* the team size is only ever set by us */
+	omp_set_dynamic(0);
+	max_threads = omp_get_max_threads();
+	if (argc == 4)
+		schedule = schedule_parse(argv[3], max_threads, &num_schedule);
+	else {
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = malleable_signal;
+		sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &sa, NULL);
+		sigaction(SIGUSR2, &sa, NULL);
+	}
+
+	simd = stream_simd_select();
+	if (simd != NULL)
+		kernel = simd->triad;
+
+	/* allocate the arrays and initialize them with all the threads, each
+	 * team size then sees its own mix of local and remote pages.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* NRM Context init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[i] + scalar*b[i];
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array.
+	 */
+	nrmb_send_progress(1.0);
+
+	struct segment *seg = NULL;
+	int threads = max_threads;
+	long int seg_iter = 0;
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+
+		/* start a new segment on a change of team size, or at the end
+		 * of a scheduled one.
+		 */
+		nrm_time_gettime(&start);
+		if (schedule != NULL) {
+			if (seg == NULL || seg_iter >= seg->count ||
+			    (seg->duration > 0 &&
+			     nrm_time_diff(&seg_start, &start) >= seg->duration))
+				seg = NULL;
+		} else {
+			int delta = __atomic_exchange_n(&signal_delta, 0,
+							__ATOMIC_RELAXED);
+			int next = NRMB_MAX(1, NRMB_MIN(max_threads,
+							threads + delta));
+			if (next != threads) {
+				threads = next;
+				seg = NULL;
+			}
+		}
+		if (seg == NULL) {
+			if (num_segments > 0)
+				segments[num_segments-1].wall =
+					nrm_time_diff(&seg_start, &start);
+			segments = realloc(segments, (num_segments + 1) *
+					   sizeof(struct segment));
+			assert(segments != NULL);
+			seg = &segments[num_segments];
+			if (schedule != NULL)
+				*seg = schedule[num_segments % num_schedule];
+			else {
+				seg->threads = threads;
+				seg->length = "signal";
+				seg->count = LONG_MAX;
+				seg->duration = 0;
+			}
+			threads = seg->threads;
+			nrmb_hist_init(&seg->hist);
+			nrmb_thread_hist_init(&seg->busy, seg->threads);
+			omp_set_num_threads(seg->threads);
+			num_segments++;
+			seg_iter = 0;
+			seg_start = start;
+		}
+
+		/* the actual benchmark */
+		stream_blocked(kernel, c, a, b, scalar, array_size, array_size,
+			       1.0, &seg->busy);
+		nrm_time_gettime(&end);
+
+		time = nrm_time_diff(&start, &end);
+		if (seg_iter++ == 0)
+			seg->first = time;
+		else
+			nrmb_hist_record(&seg->hist, time);
+	}
+	nrm_time_gettime(&end);
+	if (num_segments > 0)
+		segments[num_segments-1].wall = nrm_time_diff(&seg_start, &end);
+	omp_set_num_threads(max_threads);
+
+	nrmb_finalize();
+
+	/* report the configuration and timings: bandwidth is the steady
+	 * state of each segment, the progress rate its iterations over its
+	 * wall time, and the transition how much longer than the steady state
+	 * its first iteration took.
+	 */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, malleable Triad benchmark\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d max\n", max_threads);
+	fprintf(stdout, "Team size changes:   %s\n",
+		schedule != NULL ? "schedule" : "SIGUSR1/SIGUSR2");
+	if (simd)
+		fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, malleable Triad benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", max_threads);
+	nrmb_report_config_string(report, "changes",
+				  schedule != NULL ? "schedule" : "signal");
+	nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+	nrmb_report_config_int(report, "segments", num_segments);
+
+	for (size_t s = 0; s < num_segments; s++) {
+		struct segment *sg = &segments[s];
+		long int count = sg->hist.count + 1;
+		double steady = sg->hist.count > 0 ?
+			nrmb_hist_mean(&sg->hist) : (double)sg->first;
+		double rate = count / (1.0E-09 * sg->wall);
+		double transition = sg->first - steady;
+
+		fprintf(stdout, "Segment %3zu: threads: %3d iterations: %8ld Time (s): %11.6f Perf (MiB/s): %12.6f Progress (1/s): %10.3f Transition (s): %11.6f\n",
+			s, sg->threads, count, 1.0E-09 * sg->wall,
+			(3.0E-06 * memory_size) / (1.0E-09 * steady),
+			rate, 1.0E-09 * transition);
+		snprintf(key, sizeof(key), "Segment %3zu:", s);
+		nrmb_thread_hist_print(stdout, key, &sg->busy);
+
+		snprintf(key, sizeof(key), "Segment %zu", s);
+		nrmb_report_kernel(report, key, &sg->hist, 3.0 * memory_size);
+		snprintf(key, sizeof(key), "segment_%zu", s);
+		nrmb_report_threads(report, key, &sg->busy);
+		snprintf(key, sizeof(key), "segment_%zu_threads", s);
+		nrmb_report_metric(report, key, sg->threads);
+		snprintf(key, sizeof(key), "segment_%zu_progress_rate", s);
+		nrmb_report_metric(report, key, rate);
+		snprintf(key, sizeof(key), "segment_%zu_transition", s);
+		nrmb_report_metric(report, key, 1.0E-09 * transition);
+	}
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT)
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
+	int err = !nrmb_check_array(7.0, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark, for each of the
+	 *   fork/join and persistent versions
+	 */
+	size_t array_size;
+	long int times;
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist forkjoin[4], persistent[4];
+	struct nrmb_thread_hist fj_threads[4], pr_threads[4];
+	const char *names[4] = {"Copy", "Scale", "Add", "Triad"};
+	size_t bytes[4] = {2, 2, 3, 3};
+	nrm_time_t start, end;
+	size_t memory_size;
+	char key[64];
+	int num_threads;
+
+	assert(argc == 3);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* allocate the arrays and initialize them. Note that we expect the
+	 * first-touch policy of Linux to result in the arrays being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* NRM init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[i];
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+		b[i] = scalar*c[i];
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[i] + b[i];
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+		a[i] = b[i] + scalar*c[i];
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array.
+	 */
+	nrmb_send_progress(1.0);
+	long int passes = 1;
+
+	for(size_t i = 0; i < 4; i++) {
+		nrmb_hist_init(&forkjoin[i]);
+		nrmb_hist_init(&persistent[i]);
+		nrmb_thread_hist_init(&fj_threads[i], num_threads);
+		nrmb_thread_hist_init(&pr_threads[i], num_threads);
+	}
+
+	/* reference: one parallel region per kernel, as in ones-stream-full */
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+
+		stream_cycle_reset(a, b, c, array_size, &passes);
+		passes++;
+
+#define TSTART(k) nrm_time_gettime(&start)
+#define TEND(i) do { \
+		nrm_time_gettime(&end); \
+		time = nrm_time_diff(&start, &end); \
+		nrmb_hist_record(&forkjoin[i], time); \
+	} while(0)
+
+		TSTART(0);
+		STREAM_TIMED_FOR(&fj_threads[0], array_size, c[i] = a[i]);
+		TEND(0);
+		TSTART(1);
+		STREAM_TIMED_FOR(&fj_threads[1], array_size, b[i] = scalar*c[i]);
+		TEND(1);
+		TSTART(2);
+		STREAM_TIMED_FOR(&fj_threads[2], array_size, c[i] = a[i] + b[i]);
+		TEND(2);
+		TSTART(3);
+		STREAM_TIMED_FOR(&fj_threads[3], array_size,
+				 a[i] = b[i] + scalar*c[i]);
+		TEND(3);
+
+		nrmb_send_progress(1.0);
+	}
+
+	/* start the persistent version over from the initial values, so that
+	 * validation does not overflow any sooner than for ones-stream-full.
+	 * It runs as many iterations as the fork/join version did, which also
+	 * keeps all threads agreeing on the count when given a duration.
+	 */
+#pragma omp parallel for schedule(static)
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* persistent: a single parallel region for all iterations. Each thread
+	 * times its own share of a kernel, then all of them meet on a barrier,
+	 * after which the master thread takes one timestamp, that both ends a
+	 * kernel and starts the next one.
+	 */
+#pragma omp parallel
+	{
+		nrm_time_t last, now, tstart, tend;
+
+#pragma omp master
+		nrm_time_gettime(&last);
+#pragma omp barrier
+
+#define TNEXT(k) do { \
+		_Pragma("omp master") \
+		{ \
+			nrm_time_gettime(&now); \
+			nrmb_hist_record(&persistent[k], \
+					 nrm_time_diff(&last, &now)); \
+			last = now; \
+		} \
+	} while(0)
+#define TKERNEL(k, body) do { \
+		nrm_time_gettime(&tstart); \
+		_Pragma("omp for schedule(static) nowait") \
+		for(size_t i = 0; i < array_size; i++) \
+			body; \
+		nrm_time_gettime(&tend); \
+		nrmb_thread_hist_record(&pr_threads[k], omp_get_thread_num(), \
+					nrm_time_diff(&tstart, &tend)); \
+		_Pragma("omp barrier") \
+		TNEXT(k); \
+	} while(0)
+
+		for(long int iter = 0; iter < times; iter++)
+		{
+			/* as stream_cycle_reset, from inside the region */
+			if (iter > 0 && iter % STREAM_CYCLE_PASSES == 0) {
+#pragma omp for schedule(static)
+				for(size_t i = 0; i < array_size; i++)
+				{
+					a[i] = 1.0;
+					b[i] = 2.0;
+					c[i] = 0.0;
+				}
+#pragma omp master
+				nrm_time_gettime(&last);
+			}
+			TKERNEL(0, c[i] = a[i]);
+			TKERNEL(1, b[i] = scalar*c[i]);
+			TKERNEL(2, c[i] = a[i] + b[i]);
+			TKERNEL(3, a[i] = b[i] + scalar*c[i]);
+
+			/* only the master thread sends, the others add
+			 * nothing to their counters. The next Copy starts
+			 * from after the send, which the fork/join version
+			 * does not time either.
+			 */
+#pragma omp master
+			{
+				nrmb_send_progress(1.0);
+				nrm_time_gettime(&last);
+			}
+		}
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, Stream benchmark in a persistent parallel region\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times per version.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Stream benchmark in a persistent parallel region");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+
+	/* the difference between the two versions is the runtime overhead of
+	 * opening and closing a parallel region, compared to a barrier.
+	 */
+	for(size_t i = 0; i < 4; i++) {
+		double fj = nrmb_hist_mean(&forkjoin[i]);
+		double pr = nrmb_hist_mean(&persistent[i]);
+		fprintf(stdout, "%s Fork/join  Time (s): avg: %11.6f min: %11.6f Perf (MiB/s): best: %12.6f\n",
+			names[i], 1.0E-09 * fj, 1.0E-09 * forkjoin[i].min,
+			(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * forkjoin[i].min));
+		fprintf(stdout, "%s Persistent Time (s): avg: %11.6f min: %11.6f Perf (MiB/s): best: %12.6f\n",
+			names[i], 1.0E-09 * pr, 1.0E-09 * persistent[i].min,
+			(bytes[i] * 1.0E-06 * memory_size)/ (1.0E-09 * persistent[i].min));
+		fprintf(stdout, "%s Overhead (us): avg: %10.3f min: %10.3f\n",
+			names[i], 1.0E-03 * (fj - pr),
+			1.0E-03 * (forkjoin[i].min - persistent[i].min));
+
+		snprintf(key, sizeof(key), "%s fork/join", names[i]);
+		nrmb_thread_hist_print(stdout, key, &fj_threads[i]);
+		nrmb_report_kernel(report, key, &forkjoin[i],
+				   (double)bytes[i] * memory_size);
+		nrmb_report_threads(report, key, &fj_threads[i]);
+		snprintf(key, sizeof(key), "%s persistent", names[i]);
+		nrmb_thread_hist_print(stdout, key, &pr_threads[i]);
+		nrmb_report_kernel(report, key, &persistent[i],
+				   (double)bytes[i] * memory_size);
+		nrmb_report_threads(report, key, &pr_threads[i]);
+		snprintf(key, sizeof(key), "%s_overhead_avg", names[i]);
+		nrmb_report_metric(report, key, 1.0E-09 * (fj - pr));
+	}
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+		stream_numa_report(stdout, report, "Triad", stream_triad,
+				   a, b, c, scalar,
+				   array_size, 3, times);
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different.
+	 * Only the persistent version, from the initial values, counts, and
+	 * only its passes since the last reset.
+	 */
+	nrm_time_gettime(&start);
+	err = 0;
+	double ai, bi, ci;
+	passes = times ? (times - 1) % STREAM_CYCLE_PASSES + 1 : 0;
+	stream_cycle_replay(scalar, passes, &ai, &bi, &ci);
+	err = err || !nrmb_check_array(ai, a, array_size, 2);
+	err = err || !nrmb_check_array(bi, b, array_size, 2);
+	err = err || !nrmb_check_array(ci, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
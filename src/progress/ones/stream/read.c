@@ -0,0 +1,171 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+static double *a;
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark
+	 */
+	size_t array_size;
+	long int times;
+	double sum = 0.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist hist;
+	struct nrmb_thread_hist threads;
+	nrm_time_t start, end;
+	size_t memory_size;
+	int num_threads;
+
+	/* retrieve the size of the allocation and the number of time
+	 * to loop through the kernel.
+	 */
+	assert(argc == 3);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* allocate the array and initialize it. Note that we expect the
+	 * first-touch policy of Linux to result in the array being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		a[i] = 1.0;
+
+	/* NRM Context init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+#pragma omp parallel for reduction(+:sum)
+	for(size_t i = 0; i < array_size; i++)
+		sum += a[i];
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array.
+	 */
+	nrmb_send_progress(1.0);
+
+	nrmb_hist_init(&hist);
+	nrmb_thread_hist_init(&threads, num_threads);
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+		nrm_time_gettime(&start);
+
+		/* the actual benchmark: the simd clause allows the compiler to
+		 * reorder the sum, otherwise each thread would be bound by the
+		 * latency of its additions instead of by memory.
+		 */
+		sum = 0.0;
+#pragma omp parallel
+		{
+			nrm_time_t tstart, tend;
+			nrm_time_gettime(&tstart);
+#pragma omp for simd reduction(+:sum) nowait
+			for(size_t i = 0; i < array_size; i++)
+				sum += a[i];
+			nrm_time_gettime(&tend);
+			nrmb_thread_hist_record(&threads, omp_get_thread_num(),
+						nrm_time_diff(&tstart, &tend));
+		}
+		nrm_time_gettime(&end);
+		nrmb_send_progress(1.0);
+
+		time = nrm_time_diff(&start, &end);
+		nrmb_hist_record(&hist, time);
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, Read benchmark\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	fprintf(stdout, "Time (s): avg:       %11.6f min:  %11.6f max: %11.6f\n",
+		1.0E-09 * nrmb_hist_mean(&hist), 1.0E-09 * hist.min,
+		1.0E-09 * hist.max);
+	nrmb_hist_print(stdout, NULL, &hist);
+	nrmb_thread_hist_print(stdout, NULL, &threads);
+	fprintf(stdout, "Perf (MiB/s): avg:   %12.6f best: %12.6f\n",
+		(1.0E-06 * memory_size)/ (1.0E-09 * nrmb_hist_mean(&hist)),
+		(1.0E-06 * memory_size)/ (1.0E-09 * hist.min));
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Read benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_kernel(report, "Read", &hist, 1.0 * memory_size);
+	nrmb_report_threads(report, "Read", &threads);
+
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(stdout, report, "a", a);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		fprintf(stdout, "NUMA placement:      %s\n", nrmb_numa_spec());
+		nrmb_report_config_string(report, "numa", nrmb_numa_spec());
+		nrmb_report_metric(report, "placement_ok",
+				   nrmb_numa_check(stdout, "a", a, array_size,
+						   sizeof(double)));
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: the array is all ones, so the sum is exact
+	 * whatever the order of the additions.
+	 */
+	err = !nrmb_check_double((double)array_size, sum, 2);
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,266 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+
+/* the extra FMAs converge to BETA/(1-ALPHA) instead of overflowing, whatever
+ * their number.
+ */
+#define ROOFLINE_ALPHA 0.5
+#define ROOFLINE_BETA 1.0
+
+/* number of elements carried through the FMAs together: enough independent
+ * chains to hide the FMA latency once vectorized, few enough to stay in
+ * registers.
+ */
+#define ROOFLINE_LANES 32
+
+/* triad followed by fmas dependent FMAs on each element: 2 + 2*fmas flops for
+ * the same 24 bytes of STREAM traffic.
+ */
+static void roofline_kernel(double *dst, const double *x, const double *y,
+			    double scalar, size_t start, size_t end,
+			    long int fmas)
+{
+	size_t i = start;
+
+	for (; i + ROOFLINE_LANES <= end; i += ROOFLINE_LANES) {
+		double t[ROOFLINE_LANES];
+		for (int j = 0; j < ROOFLINE_LANES; j++)
+			t[j] = x[i+j] + scalar*y[i+j];
+		for (long int k = 0; k < fmas; k++)
+			for (int j = 0; j < ROOFLINE_LANES; j++)
+				t[j] = t[j]*ROOFLINE_ALPHA + ROOFLINE_BETA;
+		for (int j = 0; j < ROOFLINE_LANES; j++)
+			dst[i+j] = t[j];
+	}
+	for (; i < end; i++) {
+		double t = x[i] + scalar*y[i];
+		for (long int k = 0; k < fmas; k++)
+			t = t*ROOFLINE_ALPHA + ROOFLINE_BETA;
+		dst[i] = t;
+	}
+}
+
+/* one pass over the array, each thread recording the time of its share in
+ * threads, unless it is NULL.
+ */
+static void roofline_pass(size_t array_size, double scalar, long int fmas,
+			  struct nrmb_thread_hist *threads)
+{
+#pragma omp parallel
+	{
+		size_t start, end;
+		nrm_time_t tstart, tend;
+		nrm_time_gettime(&tstart);
+		nrmb_static_range(array_size, &start, &end);
+		roofline_kernel(c, a, b, scalar, start, end, fmas);
+		nrm_time_gettime(&tend);
+		if (threads != NULL)
+			nrmb_thread_hist_record(threads, omp_get_thread_num(),
+						nrm_time_diff(&tstart, &tend));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark at each intensity
+	 * - optionally, the maximum number of extra FMAs per element, the
+	 *   sweep doubles it from 0 (plain triad) up to that value.
+	 */
+	size_t array_size;
+	long int times;
+	long int max_fmas = 256;
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist *hist;
+	struct nrmb_thread_hist *threads;
+	long int *fmas;
+	nrm_time_t start, end;
+	size_t memory_size, num_points;
+	char key[64];
+	int num_threads;
+
+	assert(argc == 3 || argc == 4);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+	if (argc == 4) {
+		max_fmas = strtol(argv[3], NULL, 0);
+		assert(!errno && max_fmas >= 0);
+	}
+
+	/* 0, 1, 2, 4, ... max_fmas, which is always the last point */
+	num_points = 1;
+	for (long int f = 1; f < max_fmas; f *= 2)
+		num_points++;
+	if (max_fmas > 0)
+		num_points++;
+	fmas = calloc(num_points, sizeof(long int));
+	hist = malloc(num_points * sizeof(struct nrmb_hist));
+	threads = malloc(num_points * sizeof(struct nrmb_thread_hist));
+	assert(fmas != NULL && hist != NULL && threads != NULL);
+	for (size_t p = 1; p < num_points; p++)
+		fmas[p] = NRMB_MIN(1L << (p - 1), max_fmas);
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* allocate the arrays and initialize them. Note that we expect the
+	 * first-touch policy of Linux to result in the arrays being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* NRM Context init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+	roofline_pass(array_size, scalar, 0, NULL);
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array, whatever the intensity.
+	 */
+	nrmb_send_progress(1.0);
+
+	/* each point runs times iterations, or for the whole duration, the
+	 * report then gives the smallest count.
+	 */
+	long int runs = times;
+	for (size_t p = 0; p < num_points; p++) {
+		long int count = times;
+		nrmb_hist_init(&hist[p]);
+		nrmb_thread_hist_init(&threads[p], num_threads);
+		for(long int iter = 0; nrmb_run_next(iter, &count); iter++)
+		{
+			int64_t time;
+			nrm_time_gettime(&start);
+			roofline_pass(array_size, scalar, fmas[p], &threads[p]);
+			nrm_time_gettime(&end);
+			nrmb_send_progress(1.0);
+
+			time = nrm_time_diff(&start, &end);
+			nrmb_hist_record(&hist[p], time);
+		}
+		runs = NRMB_MIN(runs, count);
+	}
+	times = runs;
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, Triad roofline benchmark\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times per intensity.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Triad roofline benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "max_fmas", max_fmas);
+	nrmb_report_config_int(report, "threads", num_threads);
+
+	/* best time of each point, flops and bytes per element are the same
+	 * for every element of the array.
+	 */
+	for (size_t p = 0; p < num_points; p++) {
+		double flops = (2.0 + 2.0 * fmas[p]) * array_size;
+		double bytes = 3.0 * memory_size;
+		double best = 1.0E-09 * hist[p].min;
+		double tmin, tavg, tmax, imbalance;
+		nrmb_thread_hist_stats(&threads[p], &tmin, &tavg, &tmax,
+				       &imbalance);
+		fprintf(stdout, "FMAs: %5ld Intensity (flop/byte): %9.4f Time (s): avg: %11.6f min: %11.6f GFLOP/s: %10.3f GB/s: %10.3f Imbalance: %6.3f\n",
+			fmas[p], flops / bytes,
+			1.0E-09 * nrmb_hist_mean(&hist[p]), best,
+			1.0E-09 * flops / best, 1.0E-09 * bytes / best,
+			imbalance);
+		snprintf(key, sizeof(key), "Roofline %ld", fmas[p]);
+		nrmb_report_kernel(report, key, &hist[p], bytes);
+		nrmb_report_threads(report, key, &threads[p]);
+		snprintf(key, sizeof(key), "fmas_%ld_gflops", fmas[p]);
+		nrmb_report_metric(report, key, 1.0E-09 * flops / best);
+	}
+	stream_alloc_report(stdout, report, a, b, c);
+
+	/* no per node breakdown, another kernel would change c */
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT)
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: the last point leaves the result of its
+	 * FMAs on top of the triad in c, a and b are never written.
+	 */
+	nrm_time_gettime(&start);
+	err = 0;
+	double ci = 1.0 + scalar*2.0;
+	for(long int k = 0; k < fmas[num_points - 1]; k++)
+		ci = ci*ROOFLINE_ALPHA + ROOFLINE_BETA;
+	err = err || !nrmb_check_array(1.0, a, array_size, 2);
+	err = err || !nrmb_check_array(2.0, b, array_size, 2);
+	err = err || !nrmb_check_array(ci, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
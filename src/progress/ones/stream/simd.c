@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <string.h>
+
+#include "common.h"
+
+/* Hand-vectorized STREAM kernels, one set per instruction set, with regular
+ * or non-temporal stores. Each kernel runs scalar until dst is aligned on the
+ * vector size, so that both store flavors use aligned stores, and finishes
+ * the range in scalar. Non-temporal stores bypass the caches, saving the
+ * write-allocate read of dst, and are fenced before the kernel returns.
+ *
+ * Every set is compiled for its own target, the binary only uses the ones
+ * CPUID reports as available.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define STREAM_SIMD_HEAD(dst, i, end, bytes) \
+	for (; i < end && ((uintptr_t)&dst[i] & ((bytes) - 1)); i++)
+
+#define STREAM_SIMD_KERNELS(sfx, isa, vec, width, loadu, store, set1, add, \
+			    mul, fence) \
+__attribute__((target(isa))) \
+static void stream_copy_##sfx(double *dst, const double *x, const double *y, \
+			      double scalar, size_t start, size_t end) \
+{ \
+	size_t i = start; \
+	(void)y; \
+	(void)scalar; \
+	STREAM_SIMD_HEAD(dst, i, end, width * sizeof(double)) \
+		dst[i] = x[i]; \
+	for (; i + width <= end; i += width) \
+		store(&dst[i], loadu(&x[i])); \
+	for (; i < end; i++) \
+		dst[i] = x[i]; \
+	fence; \
+} \
+__attribute__((target(isa))) \
+static void stream_scale_##sfx(double *dst, const double *x, const double *y, \
+			       double scalar, size_t start, size_t end) \
+{ \
+	size_t i = start; \
+	vec s = set1(scalar); \
+	(void)y; \
+	STREAM_SIMD_HEAD(dst, i, end, width * sizeof(double)) \
+		dst[i] = scalar*x[i]; \
+	for (; i + width <= end; i += width) \
+		store(&dst[i], mul(s, loadu(&x[i]))); \
+	for (; i < end; i++) \
+		dst[i] = scalar*x[i]; \
+	fence; \
+} \
+__attribute__((target(isa))) \
+static void stream_add_##sfx(double *dst, const double *x, const double *y, \
+			     double scalar, size_t start, size_t end) \
+{ \
+	size_t i = start; \
+	(void)scalar; \
+	STREAM_SIMD_HEAD(dst, i, end, width * sizeof(double)) \
+		dst[i] = x[i] + y[i]; \
+	for (; i + width <= end; i += width) \
+		store(&dst[i], add(loadu(&x[i]), loadu(&y[i]))); \
+	for (; i < end; i++) \
+		dst[i] = x[i] + y[i]; \
+	fence; \
+} \
+__attribute__((target(isa))) \
+static void stream_triad_##sfx(double *dst, const double *x, const double *y, \
+			       double scalar, size_t start, size_t end) \
+{ \
+	size_t i = start; \
+	vec s = set1(scalar); \
+	STREAM_SIMD_HEAD(dst, i, end, width * sizeof(double)) \
+		dst[i] = x[i] + scalar*y[i]; \
+	for (; i + width <= end; i += width) \
+		store(&dst[i], add(loadu(&x[i]), mul(s, loadu(&y[i])))); \
+	for (; i < end; i++) \
+		dst[i] = x[i] + scalar*y[i]; \
+	fence; \
+} \
+__attribute__((target(isa))) \
+static void stream_fill_##sfx(double *dst, const double *x, const double *y, \
+			      double scalar, size_t start, size_t end) \
+{ \
+	size_t i = start; \
+	vec s = set1(scalar); \
+	(void)x; \
+	(void)y; \
+	STREAM_SIMD_HEAD(dst, i, end, width * sizeof(double)) \
+		dst[i] = scalar; \
+	for (; i + width <= end; i += width) \
+		store(&dst[i], s); \
+	for (; i < end; i++) \
+		dst[i] = scalar; \
+	fence; \
+}
+
+STREAM_SIMD_KERNELS(sse2, "sse2", __m128d, 2, _mm_loadu_pd, _mm_store_pd,
+		    _mm_set1_pd, _mm_add_pd, _mm_mul_pd, (void)0)
+STREAM_SIMD_KERNELS(sse2_nt, "sse2", __m128d, 2, _mm_loadu_pd, _mm_stream_pd,
+		    _mm_set1_pd, _mm_add_pd, _mm_mul_pd, _mm_sfence())
+STREAM_SIMD_KERNELS(avx2, "avx2", __m256d, 4, _mm256_loadu_pd,
+		    _mm256_store_pd, _mm256_set1_pd, _mm256_add_pd,
+		    _mm256_mul_pd, (void)0)
+STREAM_SIMD_KERNELS(avx2_nt, "avx2", __m256d, 4, _mm256_loadu_pd,
+		    _mm256_stream_pd, _mm256_set1_pd, _mm256_add_pd,
+		    _mm256_mul_pd, _mm_sfence())
+STREAM_SIMD_KERNELS(avx512, "avx512f", __m512d, 8, _mm512_loadu_pd,
+		    _mm512_store_pd, _mm512_set1_pd, _mm512_add_pd,
+		    _mm512_mul_pd, (void)0)
+STREAM_SIMD_KERNELS(avx512_nt, "avx512f", __m512d, 8, _mm512_loadu_pd,
+		    _mm512_stream_pd, _mm512_set1_pd, _mm512_add_pd,
+		    _mm512_mul_pd, _mm_sfence())
+
+#define STREAM_SIMD_ENTRY(name, sfx) \
+	{ name, stream_copy_##sfx, stream_scale_##sfx, stream_add_##sfx, \
+	  stream_triad_##sfx, stream_fill_##sfx }
+
+/* best instruction set first, each followed by its non-temporal flavor */
+static const struct stream_simd stream_simd_variants[] = {
+	STREAM_SIMD_ENTRY("avx512", avx512),
+	STREAM_SIMD_ENTRY("avx512-nt", avx512_nt),
+	STREAM_SIMD_ENTRY("avx2", avx2),
+	STREAM_SIMD_ENTRY("avx2-nt", avx2_nt),
+	STREAM_SIMD_ENTRY("sse2", sse2),
+	STREAM_SIMD_ENTRY("sse2-nt", sse2_nt),
+};
+
+static int stream_simd_supported(const char *name)
+{
+	__builtin_cpu_init();
+	if (!strncmp(name, "avx512", 6))
+		return __builtin_cpu_supports("avx512f");
+	if (!strncmp(name, "avx2", 4))
+		return __builtin_cpu_supports("avx2");
+	return __builtin_cpu_supports("sse2");
+}
+
+const struct stream_simd *stream_simd_select(void)
+{
+	const char *spec = getenv("NRMB_SIMD");
+	const size_t num = sizeof(stream_simd_variants) /
+		sizeof(stream_simd_variants[0]);
+	int nt;
+
+	if (spec == NULL || *spec == '\0')
+		return NULL;
+
+	/* auto picks the best instruction set CPUID reports */
+	nt = !strcmp(spec, "auto-nt");
+	if (nt || !strcmp(spec, "auto")) {
+		for (size_t i = nt; i < num; i += 2)
+			if (stream_simd_supported(stream_simd_variants[i].name))
+				return &stream_simd_variants[i];
+		assert(0 && "no supported SIMD kernels");
+	}
+	for (size_t i = 0; i < num; i++) {
+		if (strcmp(spec, stream_simd_variants[i].name))
+			continue;
+		assert(stream_simd_supported(spec) &&
+		       "NRMB_SIMD instruction set not supported by this CPU");
+		return &stream_simd_variants[i];
+	}
+	assert(0 && "unknown NRMB_SIMD kernels");
+	return NULL;
+}
+#else
+const struct stream_simd *stream_simd_select(void)
+{
+	const char *spec = getenv("NRMB_SIMD");
+	assert((spec == NULL || *spec == '\0') &&
+	       "SIMD kernels are only available on x86");
+	return NULL;
+}
+#endif
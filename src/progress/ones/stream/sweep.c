@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - minimum array size in number of double elements
+	 * - maximum array size in number of double elements
+	 * - number of times to run through the benchmark at each size
+	 */
+	size_t min_size, max_size, array_size;
+	long int times;
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist *hist;
+	struct nrmb_thread_hist threads[4];
+	double *imbalance;
+	const char *names[4] = {"Copy", "Scale", "Add", "Triad"};
+	stream_kernel_t kernels[4] = {stream_copy, stream_scale, stream_add,
+				      stream_triad};
+	size_t bytes[4] = {2, 2, 3, 3};
+	const struct stream_simd *simd;
+	nrm_time_t start, end;
+	size_t memory_size, num_steps;
+	char key[64];
+	int num_threads;
+
+	assert(argc == 4);
+	errno = 0;
+	min_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	errno = 0;
+	max_size = strtoull(argv[2], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[3]);
+	assert(min_size > 0 && min_size <= max_size);
+
+	/* sizes double from min_size up to max_size, which is always the last
+	 * step even if it is not a power of two multiple of min_size.
+	 */
+	num_steps = 1;
+	for (array_size = min_size; array_size < max_size; array_size *= 2)
+		num_steps++;
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	simd = stream_simd_select();
+	if (simd != NULL) {
+		kernels[0] = simd->copy;
+		kernels[1] = simd->scale;
+		kernels[2] = simd->add;
+		kernels[3] = simd->triad;
+	}
+
+	/* allocate the arrays once for the largest size, every step then works
+	 * on a prefix of them. The first-touch placement is only exact for the
+	 * largest sizes, the smaller ones are meant to live in the caches
+	 * anyway. The same goes for an explicit placement from NRMB_NUMA.
+	 */
+	nrmb_numa_init();
+	memory_size = max_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+	hist = malloc(4 * num_steps * sizeof(struct nrmb_hist));
+	imbalance = malloc(4 * num_steps * sizeof(double));
+	assert(a != NULL && b != NULL && c != NULL && hist != NULL &&
+	       imbalance != NULL);
+	/* per-thread times are only kept as the imbalance of each step, the
+	 * histograms are reused from one step to the next.
+	 */
+	for(size_t k = 0; k < 4; k++)
+		nrmb_thread_hist_init(&threads[k], num_threads);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < max_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* NRM init */
+	nrmb_init(argv[0]);
+
+	/* this version of the benchmarks reports one progress each time it is
+	 * done with an array size.
+	 */
+	long int count = times, runs = times, passes = 0;
+	array_size = min_size;
+	for (size_t s = 0; s < num_steps; s++) {
+		/* small arrays are run over several times in a row, so that
+		 * every step moves about as much memory as the largest one
+		 * and the timer resolution does not get in the way.
+		 */
+		long int reps = NRMB_MAX(max_size / array_size, 1);
+
+		/* reset the prefix, then one run for free to warm up the
+		 * caches. Repeating a kernel does not change the arrays, so
+		 * each iteration below counts as a single pass for validation.
+		 */
+#pragma omp parallel for
+		for(size_t i = 0; i < array_size; i++)
+		{
+			a[i] = 1.0;
+			b[i] = 2.0;
+			c[i] = 0.0;
+		}
+		stream_repeat(stream_copy, c, a, NULL, 0.0, array_size, 1,
+			      NULL);
+		stream_repeat(stream_scale, b, c, NULL, scalar, array_size, 1,
+			      NULL);
+		stream_repeat(stream_add, c, a, b, 0.0, array_size, 1,
+			      NULL);
+		stream_repeat(stream_triad, a, b, c, scalar, array_size, 1,
+			      NULL);
+		passes = 1;
+
+		for(size_t k = 0; k < 4; k++) {
+			nrmb_hist_init(&hist[4*s + k]);
+			nrmb_thread_hist_reset(&threads[k]);
+		}
+
+		/* each size runs times iterations, or for the whole
+		 * duration, count keeps the number of the last one and the
+		 * report gives the smallest.
+		 */
+		count = times;
+		for(long int iter = 0; nrmb_run_next(iter, &count); iter++)
+		{
+			int64_t time;
+
+			stream_cycle_reset(a, b, c, array_size, &passes);
+			passes++;
+
+#define TSTART(k) nrm_time_gettime(&start)
+#define TEND(i) do { \
+		nrm_time_gettime(&end); \
+		time = nrm_time_diff(&start, &end); \
+		nrmb_hist_record(&hist[4*s + i], time / reps); \
+	} while(0)
+
+			TSTART(0);
+			stream_repeat(kernels[0], c, a, NULL, 0.0, array_size, reps,
+				      &threads[0]);
+			TEND(0);
+			TSTART(1);
+			stream_repeat(kernels[1], b, c, NULL, scalar, array_size, reps,
+				      &threads[1]);
+			TEND(1);
+			TSTART(2);
+			stream_repeat(kernels[2], c, a, b, 0.0, array_size, reps,
+				      &threads[2]);
+			TEND(2);
+			TSTART(3);
+			stream_repeat(kernels[3], a, b, c, scalar, array_size, reps,
+				      &threads[3]);
+			TEND(3);
+		}
+
+		for(size_t k = 0; k < 4; k++) {
+			double tmin, tavg, tmax;
+			nrmb_thread_hist_stats(&threads[k], &tmin, &tavg,
+					       &tmax, &imbalance[4*s + k]);
+		}
+		nrmb_send_progress(1.0);
+		runs = NRMB_MIN(runs, count);
+		array_size = NRMB_MIN(2*array_size, max_size);
+	}
+	times = runs;
+	for(size_t k = 0; k < 4; k++)
+		nrmb_thread_hist_free(&threads[k]);
+
+	nrmb_finalize();
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per array size, Stream working-set sweep\n");
+	fprintf(stdout, "Array sizes:         %zu to %zu (elements), %zu steps.\n",
+		min_size, max_size, num_steps);
+	fprintf(stdout, "Memory per array:    %.1f MiB max.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times per size.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	if (simd)
+		fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per array size, Stream working-set sweep");
+	nrmb_report_config_int(report, "min_size", min_size);
+	nrmb_report_config_int(report, "max_size", max_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		stream_numa_placement(stdout, report, max_size, a, b, c);
+		stream_numa_report(stdout, report, "Triad", kernels[3],
+				   a, b, c, scalar,
+				   max_size, 3, count);
+	}
+
+	/* one line per size, best bandwidth of each kernel and the worst
+	 * imbalance among them, the structured report has the full statistics.
+	 */
+	fprintf(stdout, "%14s %12s", "Size (KiB)", "Elements");
+	for(size_t k = 0; k < 4; k++)
+		fprintf(stdout, " %14s", names[k]);
+	fprintf(stdout, " %10s   (best MiB/s)\n", "Imbalance");
+	array_size = min_size;
+	for (size_t s = 0; s < num_steps; s++) {
+		size_t step_size = array_size * sizeof(double);
+		fprintf(stdout, "%14.1f %12zu", (double)step_size/1024.0,
+			array_size);
+		double worst = 0.0;
+		for(size_t k = 0; k < 4; k++) {
+			struct nrmb_hist *h = &hist[4*s + k];
+			fprintf(stdout, " %14.1f",
+				(bytes[k] * 1.0E-06 * step_size)/ (1.0E-09 * h->min));
+			worst = NRMB_MAX(worst, imbalance[4*s + k]);
+			snprintf(key, sizeof(key), "%s %zu", names[k], array_size);
+			nrmb_report_kernel(report, key, h,
+					   (double)bytes[k] * step_size);
+			/* only the imbalance, for long sweeps to fit */
+			snprintf(key, sizeof(key), "%s %zu_imbalance", names[k],
+				 array_size);
+			nrmb_report_metric(report, key, imbalance[4*s + k]);
+		}
+		fprintf(stdout, " %10.3f\n", worst);
+		array_size = NRMB_MIN(2*array_size, max_size);
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different.
+	 * Only the last step is checked, it covers the whole arrays.
+	 */
+	nrm_time_gettime(&start);
+	err = 0;
+	double ai, bi, ci;
+	stream_cycle_replay(scalar, passes, &ai, &bi, &ci);
+	err = err || !nrmb_check_array(ai, a, max_size, 2);
+	err = err || !nrmb_check_array(bi, b, max_size, 2);
+	err = err || !nrmb_check_array(ci, c, max_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,291 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <string.h>
+
+#include "common.h"
+
+static double *a, *b, *c;
+
+/* Triad duty-cycled down to a target bandwidth: each thread walks its
+ * schedule(static) share in blocks, and after each block waits until the
+ * point in the pass where that much of its share is due at the target rate.
+ * Deadlines are relative to the start of the pass, so that oversleeping one
+ * block is made up by the next ones instead of adding up. Each thread records
+ * the time it spent in the kernel only, the rest of the pass is waiting.
+ */
+static void throttled_pass(stream_kernel_t kernel, double scalar,
+			   size_t array_size, size_t block_size,
+			   int64_t pass_time, int spin,
+			   struct nrmb_thread_hist *busy)
+{
+#pragma omp parallel
+	{
+		size_t start, end;
+		int64_t work = 0;
+		nrm_time_t pstart, tstart, tend;
+
+		nrm_time_gettime(&pstart);
+		nrmb_static_range(array_size, &start, &end);
+		for (size_t k = start; k < end; k += block_size) {
+			size_t stop = NRMB_MIN(k + block_size, end);
+			nrm_time_gettime(&tstart);
+			kernel(c, a, b, scalar, k, stop);
+			nrm_time_gettime(&tend);
+			work += nrm_time_diff(&tstart, &tend);
+			nrmb_send_progress(1.0 * (stop - k) / array_size);
+
+			int64_t due = (int64_t)((double)pass_time *
+						(stop - start) / (end - start));
+			int64_t left = due - nrm_time_diff(&pstart, &tend);
+			while (left > 0) {
+				if (!spin) {
+					struct timespec t = {
+						left / 1000000000,
+						left % 1000000000
+					};
+					nanosleep(&t, NULL);
+				}
+				nrm_time_gettime(&tend);
+				left = due - nrm_time_diff(&pstart, &tend);
+			}
+		}
+		nrmb_thread_hist_record(busy, omp_get_thread_num(), work);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark
+	 * - target bandwidth, in GB/s, or in percent of the measured peak
+	 *   with a % suffix
+	 * - optionally, a block size in number of elements, defaults to 64
+	 *   blocks per thread and pass
+	 * - optionally, how to wait between blocks: sleep (default) or spin
+	 */
+	size_t array_size;
+	long int times;
+	size_t block_size = 0;
+	double target, fraction = 0.0, peak = 0.0;
+	int spin = 0;
+	const struct stream_simd *simd;
+	stream_kernel_t kernel = stream_triad;
+	double scalar = 3.0;
+	char *unit;
+
+	/* needed for performance measurement */
+	struct nrmb_hist hist;
+	struct nrmb_thread_hist busy;
+	nrm_time_t start, end;
+	size_t memory_size;
+	int64_t pass_time;
+	int num_threads;
+
+	/* retrieve the size of the allocation and the number of time
+	 * to loop through the kernel.
+	 */
+	assert(argc >= 4 && argc <= 6);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+	target = strtod(argv[3], &unit);
+	assert(!errno && target > 0.0);
+	if (*unit == '%') {
+		fraction = target / 100.0;
+		target = 0.0;
+	} else
+		assert(*unit == '\0');
+	if (argc >= 5) {
+		block_size = strtoull(argv[4], NULL, 0);
+		assert(!errno && block_size > 0);
+	}
+	if (argc == 6) {
+		assert(!strcmp(argv[5], "sleep") || !strcmp(argv[5], "spin"));
+		spin = !strcmp(argv[5], "spin");
+	}
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	if (block_size == 0)
+		block_size = NRMB_MAX(array_size / num_threads / 64, 1);
+
+	simd = stream_simd_select();
+	if (simd != NULL)
+		kernel = simd->triad;
+
+	/* allocate the arrays and initialize them. Note that we expect the
+	 * first-touch policy of Linux to result in the arrays being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+	b = nrmb_alloc(memory_size);
+	c = nrmb_alloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+	{
+		a[i] = 1.0;
+		b[i] = 2.0;
+		c[i] = 0.0;
+	}
+
+	/* NRM Context init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory */
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		c[i] = a[i] + scalar*b[i];
+
+	/* a relative target needs the peak first: the best of a few
+	 * unthrottled passes, with the same kernel and blocks.
+	 */
+	if (fraction > 0.0) {
+		struct nrmb_hist calib;
+		struct nrmb_thread_hist calib_threads;
+
+		nrmb_hist_init(&calib);
+		nrmb_thread_hist_init(&calib_threads, num_threads);
+		for (int i = 0; i < 10; i++) {
+			nrm_time_gettime(&start);
+			stream_blocked(kernel, c, a, b, scalar, array_size,
+				       block_size, 0.0, &calib_threads);
+			nrm_time_gettime(&end);
+			nrmb_hist_record(&calib, nrm_time_diff(&start, &end));
+		}
+		peak = 3.0 * memory_size / (1.0E-09 * calib.min);
+		target = fraction * peak;
+	}
+	else
+		target *= 1.0E+09;
+	pass_time = (int64_t)(1.0E+09 * 3.0 * memory_size / target);
+
+	/* this version of the benchmarks reports progress after each block,
+	 * for a total of one per pass over the array.
+	 */
+	nrmb_send_progress(1.0);
+
+	nrmb_hist_init(&hist);
+	nrmb_thread_hist_init(&busy, num_threads);
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+		nrm_time_gettime(&start);
+		throttled_pass(kernel, scalar, array_size, block_size,
+			       pass_time, spin, &busy);
+		nrm_time_gettime(&end);
+
+		time = nrm_time_diff(&start, &end);
+		nrmb_hist_record(&hist, time);
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings: achieved bandwidth is over
+	 * the whole passes, waiting included, and the duty cycle the share of
+	 * a pass that threads spent in the kernel.
+	 */
+	double achieved = 3.0 * memory_size / (1.0E-09 * nrmb_hist_mean(&hist));
+	double busy_min, busy_avg, busy_max, imbalance;
+	nrmb_thread_hist_stats(&busy, &busy_min, &busy_avg, &busy_max,
+			       &imbalance);
+	double duty = busy_avg / nrmb_hist_mean(&hist);
+
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: progress per block, bandwidth-throttled Triad benchmark\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	fprintf(stdout, "Progress block:      %zu (elements).\n", block_size);
+	fprintf(stdout, "Waiting mode:        %s\n", spin ? "spin" : "sleep");
+	if (simd)
+		fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
+	if (fraction > 0.0)
+		fprintf(stdout, "Peak (MiB/s):        %12.6f\n", 1.0E-06 * peak);
+	fprintf(stdout, "Time (s): avg:       %11.6f min:  %11.6f max: %11.6f\n",
+		1.0E-09 * nrmb_hist_mean(&hist), 1.0E-09 * hist.min,
+		1.0E-09 * hist.max);
+	nrmb_hist_print(stdout, NULL, &hist);
+	nrmb_thread_hist_print(stdout, "Busy", &busy);
+	fprintf(stdout, "Perf (MiB/s): requested: %12.6f achieved: %12.6f (%.1f%%)\n",
+		1.0E-06 * target, 1.0E-06 * achieved, 100.0 * achieved / target);
+	fprintf(stdout, "Duty cycle:          %.1f%%\n", 100.0 * duty);
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"progress per block, bandwidth-throttled Triad benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_config_int(report, "block_size", block_size);
+	nrmb_report_config_string(report, "wait", spin ? "spin" : "sleep");
+	nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+	if (fraction > 0.0) {
+		nrmb_report_config_double(report, "peak_fraction", fraction);
+		nrmb_report_metric(report, "peak", 1.0E-06 * peak);
+	}
+	nrmb_report_kernel(report, "Triad", &hist, 3.0 * memory_size);
+	nrmb_report_threads(report, "Busy", &busy);
+	nrmb_report_metric(report, "requested", 1.0E-06 * target);
+	nrmb_report_metric(report, "achieved", 1.0E-06 * achieved);
+	nrmb_report_metric(report, "duty_cycle", duty);
+
+	stream_alloc_report(stdout, report, a, b, c);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT)
+		stream_numa_placement(stdout, report, array_size, a, b, c);
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
+	err = !nrmb_check_array(7.0, c, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+
+#include "common.h"
+
+static double *a;
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - array size in number of double elements
+	 * - number of times to run through the benchmark
+	 * - optionally, a block size in number of elements: each thread then
+	 *   reports progress after each block, from inside the parallel region
+	 */
+	size_t array_size;
+	long int times;
+	size_t block_size = 0;
+	const struct stream_simd *simd;
+	stream_kernel_t kernel = stream_fill;
+	double scalar = 3.0;
+
+	/* needed for performance measurement */
+	struct nrmb_hist hist;
+	struct nrmb_thread_hist threads;
+	nrm_time_t start, end;
+	size_t memory_size;
+	int num_threads;
+
+	/* retrieve the size of the allocation and the number of time
+	 * to loop through the kernel.
+	 */
+	assert(argc == 3 || argc == 4);
+	errno = 0;
+	array_size = strtoull(argv[1], NULL, 0);
+	assert(!errno);
+	times = nrmb_parse_times(argv[2]);
+	if (argc == 4) {
+		block_size = strtoull(argv[3], NULL, 0);
+		assert(!errno && block_size > 0);
+	}
+
+	/* ensure that OpenMP is giving us the right number of threads */
+#pragma omp parallel
+#pragma omp master
+	num_threads = omp_get_num_threads();
+	int err = 0;
+#pragma omp parallel
+#pragma omp atomic
+	err++;
+	assert(num_threads == err);
+	err = 0;
+
+	/* explicit SIMD kernels go through the blocked driver, with a single
+	 * block per thread unless a block size was given. Their non-temporal
+	 * flavor is the only one without a write-allocate read of the array.
+	 */
+	simd = stream_simd_select();
+	if (simd != NULL)
+		kernel = simd->fill;
+
+	/* allocate the array and initialize it. Note that we expect the
+	 * first-touch policy of Linux to result in the array being properly
+	 * balanced between threads/numa-nodes, unless NRMB_NUMA asks for an
+	 * explicit placement.
+	 */
+	nrmb_numa_init();
+	memory_size = array_size * sizeof(double);
+	a = nrmb_alloc(memory_size);
+
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		a[i] = 0.0;
+
+	/* NRM Context init */
+	nrmb_init(argv[0]);
+
+	/* one run of the benchmark for free, warms up the memory. It writes
+	 * another value than the timed loop, so that validation can tell
+	 * whether the timed loop ran.
+	 */
+#pragma omp parallel for
+	for(size_t i = 0; i < array_size; i++)
+		a[i] = -scalar;
+
+	/* this version of the benchmarks reports one progress each time it goes
+	 * through the entire array.
+	 */
+	nrmb_send_progress(1.0);
+
+	nrmb_hist_init(&hist);
+	nrmb_thread_hist_init(&threads, num_threads);
+	for(long int iter = 0; nrmb_run_next(iter, &times); iter++)
+	{
+		int64_t time;
+		nrm_time_gettime(&start);
+
+		/* the actual benchmark */
+		if (block_size || simd) {
+			stream_blocked(kernel, a, NULL, NULL, scalar, array_size,
+				       block_size ? block_size : array_size,
+				       1.0, &threads);
+			nrm_time_gettime(&end);
+		} else {
+			STREAM_TIMED_FOR(&threads, array_size, a[i] = scalar);
+			nrm_time_gettime(&end);
+			nrmb_send_progress(1.0);
+		}
+
+		time = nrm_time_diff(&start, &end);
+		nrmb_hist_record(&hist, time);
+	}
+
+	nrmb_finalize();
+
+	/* report the configuration and timings, counting only the bytes
+	 * written, as STREAM does.
+	 */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per iteration, Write benchmark\n");
+	fprintf(stdout, "Array size:          %zu (elements).\n", array_size);
+	fprintf(stdout, "Memory per array:    %.1f MiB.\n",
+		(double) memory_size /1024.0/1024.0);
+	fprintf(stdout, "Kernel was executed: %ld times.\n", times);
+	fprintf(stdout, "Number of threads:   %d\n", num_threads);
+	if (block_size)
+		fprintf(stdout, "Progress block:      %zu (elements).\n", block_size);
+	if (simd)
+		fprintf(stdout, "SIMD kernels:        %s\n", simd->name);
+	fprintf(stdout, "Time (s): avg:       %11.6f min:  %11.6f max: %11.6f\n",
+		1.0E-09 * nrmb_hist_mean(&hist), 1.0E-09 * hist.min,
+		1.0E-09 * hist.max);
+	nrmb_hist_print(stdout, NULL, &hist);
+	nrmb_thread_hist_print(stdout, NULL, &threads);
+	fprintf(stdout, "Perf (MiB/s): avg:   %12.6f best: %12.6f\n",
+		(1.0E-06 * memory_size)/ (1.0E-09 * nrmb_hist_mean(&hist)),
+		(1.0E-06 * memory_size)/ (1.0E-09 * hist.min));
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per iteration, Write benchmark");
+	nrmb_report_config_int(report, "array_size", array_size);
+	nrmb_report_config_int(report, "memory_per_array", memory_size);
+	nrmb_report_config_int(report, "times", times);
+	nrmb_report_config_int(report, "threads", num_threads);
+	nrmb_report_config_int(report, "block_size", block_size);
+	nrmb_report_config_string(report, "simd", simd ? simd->name : "compiler");
+	nrmb_report_kernel(report, "Write", &hist, 1.0 * memory_size);
+	nrmb_report_threads(report, "Write", &threads);
+
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(stdout, report, "a", a);
+
+	if (nrmb_numa_mode() != NRMB_NUMA_DEFAULT) {
+		fprintf(stdout, "NUMA placement:      %s\n", nrmb_numa_spec());
+		nrmb_report_config_string(report, "numa", nrmb_numa_spec());
+		nrmb_report_metric(report, "placement_ok",
+				   nrmb_numa_check(stdout, "a", a, array_size,
+						   sizeof(double)));
+		stream_numa_report(stdout, report, "Write", kernel,
+				   a, NULL, NULL, scalar,
+				   array_size, 1, times);
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: minimum about of bits should be different. */
+	nrm_time_gettime(&start);
+	err = !nrmb_check_array(times ? scalar : -scalar, a, array_size, 2);
+	nrm_time_gettime(&end);
+	fprintf(stdout, "Validation (s):      %11.6f\n",
+		1.0E-09 * nrm_time_diff(&start, &end));
+	nrmb_report_metric(report, "validation_time",
+			   1.0E-09 * nrm_time_diff(&start, &end));
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
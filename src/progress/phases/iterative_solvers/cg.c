@@ -25,6 +25,7 @@
 #include "common.h"
 
 static double *A, *b, *x;
+static struct nrmb_hist iter_hist;
 int LOG;
 
 void conjugate_gradient(double *A, double *b, double *x, int n)
@@ -33,9 +34,9 @@ void conjugate_gradient(double *A, double *b, double *x, int n)
     int total_iterations = 0;
 
 	double *r, *p, *Ap;
-    r = (double *)malloc(n * sizeof(double));
-    p = (double *)malloc(n * sizeof(double));
-    Ap = (double *)malloc(n * sizeof(double));
+    r = (double *)nrmb_alloc(n * sizeof(double));
+    p = (double *)nrmb_alloc(n * sizeof(double));
+    Ap = (double *)nrmb_alloc(n * sizeof(double));
 
     nrmb_send_progress(1.0);
     cblas_dcopy(n, b, 1, r, 1);
@@ -50,6 +51,9 @@ void conjugate_gradient(double *A, double *b, double *x, int n)
 
     for (int iter = 0; iter <= n; iter++)
     {
+        nrm_time_t iter_start, iter_end;
+        nrm_time_gettime(&iter_start);
+
         cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, 1.0, A, n, p, 1, 0.0, Ap, 1);
 
 	nrmb_send_progress(1.0);
@@ -82,11 +86,13 @@ void conjugate_gradient(double *A, double *b, double *x, int n)
             printf("Step: %d Error: %.11lf\n", iter, sqrt(old_residual));
         }
 		total_iterations = iter;
+        nrm_time_gettime(&iter_end);
+        nrmb_hist_record(&iter_hist, nrm_time_diff(&iter_start, &iter_end));
     }
 
-    free(r);
-    free(p);
-    free(Ap);
+    nrmb_free(r);
+    nrmb_free(p);
+    nrmb_free(Ap);
 	
 	printf("CG total iterations: %d\n", total_iterations);
 }
@@ -99,11 +105,12 @@ int main(int argc, char *argv[])
     char *conditionning = argv[2];
     LOG = atoi(argv[3]);
 
-    A = (double *)malloc(n * n * sizeof(double));
-    b = (double *)malloc(n * sizeof(double));
-    x = (double *)malloc(n * sizeof(double));
+    A = (double *)nrmb_alloc(n * n * sizeof(double));
+    b = (double *)nrmb_alloc(n * sizeof(double));
+    x = (double *)nrmb_alloc(n * sizeof(double));
 
     nrmb_init(argv[0]);
+    nrmb_hist_init(&iter_hist);
     nrmb_send_progress(1.0);
 
     if (strcmp(conditionning, "good") == 0)
@@ -132,10 +139,23 @@ int main(int argc, char *argv[])
     time = (finish.tv_sec - start.tv_sec);
     time += (finish.tv_usec - start.tv_usec)/1e6;
 	printf("CG time: %f\n", time);
-
-	free(A);
-    free(b);
-    free(x);
+	nrmb_hist_print(stdout, "CG iteration", &iter_hist);
+
+	/* structured version of the report */
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per operation, CG solver");
+	nrmb_report_config_int(report, "n", n);
+	nrmb_report_config_string(report, "conditioning", conditionning);
+	nrmb_report_config_int(report, "threads", omp_get_max_threads());
+	nrmb_report_kernel(report, "CG iteration", &iter_hist, 0.0);
+	nrmb_report_metric(report, "time", time);
+	nrmb_report_config_string(report, "pages", nrmb_alloc_spec());
+	nrmb_alloc_report(stdout, report, "A", A);
+	nrmb_report_finalize(report);
+
+	nrmb_free(A);
+    nrmb_free(b);
+    nrmb_free(x);
 
     return 0;
 }
@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <math.h>
+#include <string.h>
+
+#include <cblas.h>
+
+#include "progress/ones/stream/common.h"
+#include "progress/ones/npb/npb.h"
+#include "progress/ones/iterative_solvers/common.h"
+#include "mixed.h"
+
+static const struct {
+	const char *name;
+	size_t size;
+} kernels[MIXED_KERNELS] = {
+	{"triad", 1 << 22},
+	{"ep", 20},
+	{"is", 20},
+	{"cg", 1000},
+	{"idle", 0},
+};
+
+static size_t sizes[MIXED_KERNELS];
+static int ready[MIXED_KERNELS];
+
+/* triad */
+static double *a, *b, *c;
+static double scalar = 3.0;
+static stream_kernel_t triad = stream_triad;
+
+/* EP */
+static double ep_a = 1220703125.0, ep_s = 271828183.0;
+static double ep_an, ep_gc, ep_rx, ep_ry;
+
+/* IS */
+static int64_t *rank_time;
+
+/* CG, restarted from scratch once it ran as many iterations as the order of
+ * the matrix, or converged.
+ */
+static double *cg_A, *cg_b, *cg_x;
+static struct cg_state cg;
+static long int cg_iter;
+
+enum mixed_kernel mixed_parse(char *spec)
+{
+	enum mixed_kernel k;
+	char *size = strchr(spec, ':');
+
+	if (size != NULL)
+		*size++ = '\0';
+	for (k = 0; k < MIXED_KERNELS; k++)
+		if (!strcmp(spec, kernels[k].name))
+			break;
+	if (k == MIXED_KERNELS) {
+		fprintf(stderr, "nrmb: unknown kernel: %s\n", spec);
+		assert(0);
+	}
+
+	if (size != NULL) {
+		size_t s;
+		errno = 0;
+		s = strtoull(size, NULL, 0);
+		assert(!errno && s > 0);
+		assert(sizes[k] == 0 || sizes[k] == s);
+		sizes[k] = s;
+	}
+	return k;
+}
+
+const char *mixed_name(enum mixed_kernel k)
+{
+	return kernels[k].name;
+}
+
+size_t mixed_size(enum mixed_kernel k)
+{
+	return sizes[k] ? sizes[k] : kernels[k].size;
+}
+
+void mixed_setup(enum mixed_kernel k, int max_threads)
+{
+	if (ready[k])
+		return;
+	ready[k] = 1;
+	sizes[k] = mixed_size(k);
+
+	switch (k) {
+	case MIXED_TRIAD: {
+		size_t n = sizes[k];
+		const struct stream_simd *simd = stream_simd_select();
+		if (simd != NULL)
+			triad = simd->triad;
+		a = nrmb_alloc(n * sizeof(double));
+		b = nrmb_alloc(n * sizeof(double));
+		c = nrmb_alloc(n * sizeof(double));
+#pragma omp parallel for
+		for(size_t i = 0; i < n; i++)
+		{
+			a[i] = 1.0;
+			b[i] = 2.0;
+			c[i] = 0.0;
+		}
+		stream_repeat(triad, c, a, b, scalar, n, 1, NULL);
+		break;
+	}
+	case MIXED_EP:
+		assert(sizes[k] >= MK);
+		ep_an = ep_setup(ep_a);
+		break;
+	case MIXED_IS:
+		rank_time = calloc(max_threads, sizeof(int64_t));
+		assert(rank_time != NULL);
+		is_setup(sizes[k], max_threads);
+		is_kernel(1, rank_time);
+		break;
+	case MIXED_CG: {
+		int n = sizes[k];
+		cg_A = nrmb_alloc((size_t)n * n * sizeof(double));
+		cg_b = nrmb_alloc(n * sizeof(double));
+		cg_x = nrmb_alloc(n * sizeof(double));
+		initialize_symmetric_positive_good_conditioning(cg_A, cg_b, cg_x, n);
+		cg_setup(&cg, cg_A, cg_b, cg_x, n);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void mixed_step(enum mixed_kernel k, long int iter,
+		struct nrmb_thread_hist *busy)
+{
+	switch (k) {
+	case MIXED_TRIAD:
+		stream_blocked(triad, c, a, b, scalar, sizes[k], sizes[k], 1.0,
+			       busy);
+		break;
+	case MIXED_EP:
+		ep_kernel(&ep_gc, &ep_rx, &ep_ry, ep_a, ep_s, ep_an,
+			  (size_t)1 << (sizes[k] - MK), busy);
+		nrmb_send_progress(1.0);
+		break;
+	case MIXED_IS:
+		for (int t = 0; t < busy->num_threads; t++)
+			rank_time[t] = 0;
+		is_kernel(iter % MAX_ITERATIONS, rank_time);
+		for (int t = 0; t < busy->num_threads; t++)
+			nrmb_thread_hist_record(busy, t, rank_time[t]);
+		nrmb_send_progress(1.0);
+		break;
+	case MIXED_CG:
+		if (cg_iter > cg.n || cg.old_residual < 1e-20) {
+			cg_release(&cg);
+			for (int j = 0; j < cg.n; j++)
+				cg_x[j] = 0.0;
+			cg_setup(&cg, cg_A, cg_b, cg_x, cg.n);
+			cg_iter = 0;
+		}
+		cg_step(&cg);
+		cg_iter++;
+		nrmb_send_progress(1.0);
+		break;
+	case MIXED_IDLE:
+	default: {
+		struct timespec t = { 0, 1000000 };
+		nanosleep(&t, NULL);
+		break;
+	}
+	}
+}
+
+int mixed_threads_timed(enum mixed_kernel k)
+{
+	return k == MIXED_TRIAD || k == MIXED_EP || k == MIXED_IS;
+}
+
+double mixed_bytes(enum mixed_kernel k)
+{
+	if (k == MIXED_TRIAD)
+		return 3.0 * mixed_size(k) * sizeof(double);
+	return 0.0;
+}
+
+int mixed_check(void)
+{
+	/* only triad has a closed form, its output stays the same however
+	 * many times it runs.
+	 */
+	if (c == NULL)
+		return 0;
+	return !nrmb_check_array(7.0, c, sizes[MIXED_TRIAD], 2);
+}
@@ -0,0 +1,57 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#ifndef NRMB_MIXED_H
+#define NRMB_MIXED_H 1
+
+/* Kernels of the mixed workloads: STREAM Triad, NPB EP and IS, CG and idle,
+ * each run one step at a time. Kernels keep their data from one step to the
+ * next, so that a kernel coming back finds its working set as it left it.
+ */
+enum mixed_kernel {
+	MIXED_TRIAD,
+	MIXED_EP,
+	MIXED_IS,
+	MIXED_CG,
+	MIXED_IDLE,
+	MIXED_KERNELS,
+};
+
+/* kernel[:size], the size being elements per array for triad, M for EP, T
+ * for IS and the matrix order for CG. A kernel has a single size per
+ * process, the default one unless given. Modifies spec.
+ */
+enum mixed_kernel mixed_parse(char *spec);
+const char *mixed_name(enum mixed_kernel k);
+size_t mixed_size(enum mixed_kernel k);
+
+/* allocate and warm up the data of a kernel, for teams of up to max_threads
+ * threads. Does nothing if the kernel is already set up.
+ */
+void mixed_setup(enum mixed_kernel k, int max_threads);
+
+/* one step of a kernel with the current team, iter counting the steps. Each
+ * step reports one progress, except for idle steps that sleep for a
+ * millisecond and report none. Triad, EP and IS record the time of each
+ * thread of the team in busy.
+ */
+void mixed_step(enum mixed_kernel k, long int iter,
+		struct nrmb_thread_hist *busy);
+
+/* whether the kernel records thread times, and the bytes it moves per step,
+ * 0 when bandwidth is not its figure of merit.
+ */
+int mixed_threads_timed(enum mixed_kernel k);
+double mixed_bytes(enum mixed_kernel k);
+
+/* post validation of the kernels that have a closed form, 0 when valid */
+int mixed_check(void);
+
+#endif
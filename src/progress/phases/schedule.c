@@ -0,0 +1,224 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <nrm.h>
+#include <limits.h>
+#include <string.h>
+
+#include "mixed.h"
+
+/* Phase schedule: runs a sequence of phases, each one a kernel repeated a
+ * number of times or for a duration, on its own number of threads. A step is
+ * one run of the kernel, see mixed.h for the kernels.
+ */
+struct phase {
+	enum mixed_kernel kernel;
+	const char *length;
+	long int count;
+	int64_t duration;
+	int threads;
+	struct nrmb_hist hist;
+	struct nrmb_thread_hist busy;
+};
+
+/* parse one entry: kernel[:size] count|duration [threads] */
+static void phase_parse(struct phase *ph, char *entry, int max_threads)
+{
+	char *save, *name, *length, *threads;
+
+	name = strtok_r(entry, " \t\n,", &save);
+	length = strtok_r(NULL, " \t\n,", &save);
+	threads = strtok_r(NULL, " \t\n,", &save);
+	assert(name != NULL && length != NULL);
+	assert(strtok_r(NULL, " \t\n,", &save) == NULL);
+
+	ph->kernel = mixed_parse(name);
+
+	ph->length = strdup(length);
+	ph->duration = nrmb_parse_duration(length);
+	if (ph->duration > 0)
+		ph->count = LONG_MAX;
+	else {
+		errno = 0;
+		ph->count = strtol(length, NULL, 0);
+		assert(!errno && ph->count >= 0);
+	}
+
+	ph->threads = max_threads;
+	if (threads != NULL) {
+		errno = 0;
+		ph->threads = strtol(threads, NULL, 0);
+		assert(!errno && ph->threads > 0 && ph->threads <= max_threads);
+	}
+}
+
+/* the schedule is either a file with one entry per line, where # starts a
+ * comment, or one entry per command line argument.
+ */
+static struct phase *schedule_parse(int argc, char **argv, int max_threads,
+				    size_t *num_phases)
+{
+	struct phase *phases = NULL;
+	size_t n = 0;
+	FILE *f = NULL;
+	char *line = NULL;
+	size_t len = 0;
+
+	if (argc == 2)
+		f = fopen(argv[1], "r");
+	for (int i = 1; ; i++) {
+		char *entry;
+		if (f != NULL) {
+			if (getline(&line, &len, f) < 0)
+				break;
+			if (strchr(line, '#') != NULL)
+				*strchr(line, '#') = '\0';
+			if (strspn(line, " \t\n,") == strlen(line))
+				continue;
+			entry = line;
+		} else if (i < argc)
+			entry = argv[i];
+		else
+			break;
+		phases = realloc(phases, (n + 1) * sizeof(struct phase));
+		assert(phases != NULL);
+		phase_parse(&phases[n++], entry, max_threads);
+	}
+	if (f != NULL)
+		fclose(f);
+	free(line);
+
+	assert(n > 0);
+	*num_phases = n;
+	return phases;
+}
+
+int main(int argc, char **argv)
+{
+	/* configuration parameters:
+	 * - a schedule file, or one schedule entry per argument. Each entry
+	 *   is a kernel (triad, ep, is, cg or idle) with an optional problem
+	 *   size after a colon, a number of steps or a duration, and
+	 *   optionally a number of threads, defaulting to all of them.
+	 */
+	struct phase *phases;
+	size_t num_phases;
+	int max_threads;
+	nrm_time_t start, end, phase_start;
+	nrm_time_t progress_start, progress_end;
+	int64_t progress_time;
+	char key[128];
+
+	assert(argc >= 2);
+	max_threads = omp_get_max_threads();
+	phases = schedule_parse(argc, argv, max_threads, &num_phases);
+
+	/* set up every kernel with all the threads, so that first-touch
+	 * spreads their data as much as the largest phase.
+	 */
+	nrmb_numa_init();
+	for (size_t p = 0; p < num_phases; p++)
+		mixed_setup(phases[p].kernel, max_threads);
+
+	/* NRM init */
+	nrmb_init(argv[0]);
+	nrm_time_gettime(&progress_start);
+	nrmb_send_progress(1.0);
+
+	for (size_t p = 0; p < num_phases; p++) {
+		struct phase *ph = &phases[p];
+		long int iter;
+
+		omp_set_num_threads(ph->threads);
+		nrmb_hist_init(&ph->hist);
+		nrmb_thread_hist_init(&ph->busy, ph->threads);
+		nrm_time_gettime(&phase_start);
+		for (iter = 0; iter < ph->count; iter++) {
+			if (ph->duration > 0 && iter > 0) {
+				nrm_time_gettime(&start);
+				if (nrm_time_diff(&phase_start, &start) >=
+				    ph->duration)
+					break;
+			}
+			nrm_time_gettime(&start);
+			mixed_step(ph->kernel, iter, &ph->busy);
+			nrm_time_gettime(&end);
+			nrmb_hist_record(&ph->hist, nrm_time_diff(&start, &end));
+		}
+		ph->count = iter;
+	}
+	omp_set_num_threads(max_threads);
+
+	nrm_time_gettime(&progress_end);
+	nrmb_finalize();
+	progress_time = nrm_time_diff(&progress_start, &progress_end);
+
+	/* report the configuration and timings */
+	fprintf(stdout, "NRM Benchmarks:      %s\n", argv[0]);
+	fprintf(stdout, "Version:             %s\n", PACKAGE_VERSION);
+	fprintf(stdout, "Description: one progress per step, phase schedule of mixed kernels\n");
+	fprintf(stdout, "Number of phases:    %zu\n", num_phases);
+	fprintf(stdout, "Number of threads:   %d max\n", max_threads);
+	fprintf(stdout, "Time (s):            %11.6f\n", 1.0E-09 * progress_time);
+
+	struct nrmb_report *report = nrmb_report_create(argv[0],
+		"one progress per step, phase schedule of mixed kernels");
+	nrmb_report_config_int(report, "phases", num_phases);
+	nrmb_report_config_int(report, "threads", max_threads);
+	for (int k = 0; k < MIXED_KERNELS; k++) {
+		if (k == MIXED_IDLE)
+			continue;
+		snprintf(key, sizeof(key), "%s_size", mixed_name(k));
+		nrmb_report_config_int(report, key, mixed_size(k));
+	}
+	nrmb_report_metric(report, "time", 1.0E-09 * progress_time);
+
+	for (size_t p = 0; p < num_phases; p++) {
+		struct phase *ph = &phases[p];
+
+		fprintf(stdout, "Phase %3zu: %-5s %-8s threads: %3d steps: %8ld Time (s): avg: %11.6f total: %11.6f\n",
+			p, mixed_name(ph->kernel), ph->length, ph->threads,
+			ph->count, 1.0E-09 * nrmb_hist_mean(&ph->hist),
+			1.0E-09 * ph->hist.sum);
+		snprintf(key, sizeof(key), "Phase %zu %s", p,
+			 mixed_name(ph->kernel));
+		nrmb_report_kernel(report, key, &ph->hist,
+				   mixed_bytes(ph->kernel));
+		snprintf(key, sizeof(key), "phase_%zu_threads", p);
+		nrmb_report_metric(report, key, ph->threads);
+		if (mixed_threads_timed(ph->kernel)) {
+			snprintf(key, sizeof(key), "Phase %3zu:", p);
+			nrmb_thread_hist_print(stdout, key, &ph->busy);
+			snprintf(key, sizeof(key), "phase_%zu", p);
+			nrmb_report_threads(report, key, &ph->busy);
+		}
+	}
+
+#ifdef ENABLE_POST_VALIDATION
+	/* validate the benchmark: only the kernels with a closed form */
+	int err = mixed_check();
+
+	if(err)
+		fprintf(stdout, "VALIDATION FAILED!!!!\n");
+	else
+		fprintf(stdout, "VALIDATION PASSED!!!!\n");
+	nrmb_report_validation(report, err);
+	nrmb_report_finalize(report);
+	return err;
+#else
+	fprintf(stdout, "VALIDATION disabled\n");
+	nrmb_report_finalize(report);
+	return 0;
+#endif
+}
@@ -0,0 +1,370 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Structured results: benchmarks fill a report with their configuration,
+ * per-kernel timings, figures of merit and validation status, on top of their
+ * human-readable output. At finalize, the report is emitted as a single JSON
+ * line or as CSV rows, depending on NRMB_REPORT, on stdout or appended to the
+ * NRMB_REPORT_FILE file, so that sweeps can accumulate results in one place.
+ */
+#define NRMB_REPORT_MAX 256
+
+enum nrmb_report_type {
+	NRMB_REPORT_INT,
+	NRMB_REPORT_DOUBLE,
+	NRMB_REPORT_STRING,
+};
+
+struct nrmb_report_entry {
+	char *name;
+	enum nrmb_report_type type;
+	long long ival;
+	double dval;
+	char *sval;
+};
+
+struct nrmb_report_kernel {
+	char *name;
+	uint64_t count;
+	double avg, min, max, p50, p90, p99, p999;
+	double perf_avg, perf_best;
+};
+
+struct nrmb_report {
+	char *benchmark;
+	char *description;
+	const char *validation;
+	size_t num_config, num_metrics, num_kernels;
+	struct nrmb_report_entry config[NRMB_REPORT_MAX];
+	struct nrmb_report_entry metrics[NRMB_REPORT_MAX];
+	struct nrmb_report_kernel kernels[NRMB_REPORT_MAX];
+};
+
+struct nrmb_report *nrmb_report_create(const char *benchmark,
+				       const char *description)
+{
+	struct nrmb_report *r = calloc(1, sizeof(struct nrmb_report));
+	assert(r != NULL);
+	r->benchmark = strdup(benchmark);
+	r->description = strdup(description);
+	r->validation = "disabled";
+	if (nrmb_run_duration() > 0)
+		nrmb_report_config_double(r, "duration",
+					  1.0E-09 * nrmb_run_duration());
+	return r;
+}
+
+static struct nrmb_report_entry *nrmb_report_entry(struct nrmb_report_entry *e,
+						   size_t *num,
+						   const char *name,
+						   enum nrmb_report_type type)
+{
+	assert(*num < NRMB_REPORT_MAX);
+	e = &e[(*num)++];
+	e->name = strdup(name);
+	e->type = type;
+	return e;
+}
+
+void nrmb_report_config_int(struct nrmb_report *r, const char *key,
+			    long long value)
+{
+	nrmb_report_entry(r->config, &r->num_config, key,
+			  NRMB_REPORT_INT)->ival = value;
+}
+
+void nrmb_report_config_double(struct nrmb_report *r, const char *key,
+			       double value)
+{
+	nrmb_report_entry(r->config, &r->num_config, key,
+			  NRMB_REPORT_DOUBLE)->dval = value;
+}
+
+void nrmb_report_config_string(struct nrmb_report *r, const char *key,
+			       const char *value)
+{
+	nrmb_report_entry(r->config, &r->num_config, key,
+			  NRMB_REPORT_STRING)->sval = strdup(value);
+}
+
+void nrmb_report_metric(struct nrmb_report *r, const char *key, double value)
+{
+	nrmb_report_entry(r->metrics, &r->num_metrics, key,
+			  NRMB_REPORT_DOUBLE)->dval = value;
+}
+
+void nrmb_report_kernel(struct nrmb_report *r, const char *name,
+			const struct nrmb_hist *h, double bytes)
+{
+	assert(r->num_kernels < NRMB_REPORT_MAX);
+	struct nrmb_report_kernel *k = &r->kernels[r->num_kernels++];
+	k->name = strdup(name);
+	k->count = h->count;
+	k->avg = 1.0E-09 * nrmb_hist_mean(h);
+	k->min = 1.0E-09 * h->min;
+	k->max = 1.0E-09 * h->max;
+	k->p50 = 1.0E-09 * nrmb_hist_percentile(h, 50.0);
+	k->p90 = 1.0E-09 * nrmb_hist_percentile(h, 90.0);
+	k->p99 = 1.0E-09 * nrmb_hist_percentile(h, 99.0);
+	k->p999 = 1.0E-09 * nrmb_hist_percentile(h, 99.9);
+	/* same units as the Perf (MiB/s) lines of the text output */
+	if (bytes > 0.0 && h->count > 0) {
+		k->perf_avg = (1.0E-06 * bytes) / k->avg;
+		k->perf_best = (1.0E-06 * bytes) / k->min;
+	}
+}
+
+void nrmb_report_threads(struct nrmb_report *r, const char *name,
+			 const struct nrmb_thread_hist *t)
+{
+	double min, avg, max, imbalance;
+	char key[128];
+
+	nrmb_thread_hist_stats(t, &min, &avg, &max, &imbalance);
+	snprintf(key, sizeof(key), "%s_thread_min", name);
+	nrmb_report_metric(r, key, 1.0E-09 * min);
+	snprintf(key, sizeof(key), "%s_thread_avg", name);
+	nrmb_report_metric(r, key, 1.0E-09 * avg);
+	snprintf(key, sizeof(key), "%s_thread_max", name);
+	nrmb_report_metric(r, key, 1.0E-09 * max);
+	snprintf(key, sizeof(key), "%s_imbalance", name);
+	nrmb_report_metric(r, key, imbalance);
+}
+
+void nrmb_report_validation(struct nrmb_report *r, int err)
+{
+	r->validation = err ? "failed" : "passed";
+}
+
+static void nrmb_report_json_string(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(out, "\\u%04x", *s);
+		else
+			fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+/* JSON has no inf or nan, those become null */
+static void nrmb_report_json_double(FILE *out, const char *format, double v)
+{
+	if (isfinite(v))
+		fprintf(out, format, v);
+	else
+		fprintf(out, "null");
+}
+
+static void nrmb_report_json_entries(FILE *out,
+				     const struct nrmb_report_entry *e,
+				     size_t num)
+{
+	fputc('{', out);
+	for (size_t i = 0; i < num; i++) {
+		if (i)
+			fputc(',', out);
+		nrmb_report_json_string(out, e[i].name);
+		fputc(':', out);
+		switch (e[i].type) {
+		case NRMB_REPORT_INT:
+			fprintf(out, "%lld", e[i].ival);
+			break;
+		case NRMB_REPORT_DOUBLE:
+			nrmb_report_json_double(out, "%.17g", e[i].dval);
+			break;
+		case NRMB_REPORT_STRING:
+			nrmb_report_json_string(out, e[i].sval);
+			break;
+		}
+	}
+	fputc('}', out);
+}
+
+static void nrmb_report_json(FILE *out, const struct nrmb_report *r)
+{
+	fprintf(out, "{\"benchmark\":");
+	nrmb_report_json_string(out, r->benchmark);
+	fprintf(out, ",\"version\":\"%s\",\"description\":", PACKAGE_VERSION);
+	nrmb_report_json_string(out, r->description);
+	fprintf(out, ",\"config\":");
+	nrmb_report_json_entries(out, r->config, r->num_config);
+	fprintf(out, ",\"kernels\":[");
+	for (size_t i = 0; i < r->num_kernels; i++) {
+		const struct nrmb_report_kernel *k = &r->kernels[i];
+		const char *keys[] = {"avg", "min", "max", "p50", "p90", "p99",
+			"p99.9", "perf_avg", "perf_best"};
+		double values[] = {k->avg, k->min, k->max, k->p50, k->p90,
+			k->p99, k->p999, k->perf_avg, k->perf_best};
+		if (i)
+			fputc(',', out);
+		fprintf(out, "{\"name\":");
+		nrmb_report_json_string(out, k->name);
+		fprintf(out, ",\"count\":%" PRIu64, k->count);
+		for (size_t j = 0; j < sizeof(keys)/sizeof(keys[0]); j++) {
+			fprintf(out, ",\"%s\":", keys[j]);
+			nrmb_report_json_double(out, "%.9g", values[j]);
+		}
+		fputc('}', out);
+	}
+	fprintf(out, "],\"metrics\":");
+	nrmb_report_json_entries(out, r->metrics, r->num_metrics);
+	fprintf(out, ",\"validation\":\"%s\"}\n", r->validation);
+}
+
+/* CSV is in long form, one value per row, so that runs of different
+ * benchmarks can share a file: benchmark,section,name,key,value. Strings are
+ * quoted when they need to be, and inf or nan values are left empty.
+ */
+static void nrmb_report_csv_string(FILE *out, const char *s)
+{
+	if (strpbrk(s, ",\"\r\n") == NULL) {
+		fputs(s, out);
+		return;
+	}
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"')
+			fputc('"', out);
+		fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+static void nrmb_report_csv_double(FILE *out, const char *format, double v)
+{
+	if (isfinite(v))
+		fprintf(out, format, v);
+}
+
+/* benchmark,section,name,key, with the trailing comma */
+static void nrmb_report_csv_prefix(FILE *out, const struct nrmb_report *r,
+				   const char *section, const char *name,
+				   const char *key)
+{
+	nrmb_report_csv_string(out, r->benchmark);
+	fprintf(out, ",%s,", section);
+	nrmb_report_csv_string(out, name);
+	fputc(',', out);
+	nrmb_report_csv_string(out, key);
+	fputc(',', out);
+}
+
+static void nrmb_report_csv_entries(FILE *out, const struct nrmb_report *r,
+				    const char *section,
+				    const struct nrmb_report_entry *e,
+				    size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		nrmb_report_csv_prefix(out, r, section, "", e[i].name);
+		switch (e[i].type) {
+		case NRMB_REPORT_INT:
+			fprintf(out, "%lld", e[i].ival);
+			break;
+		case NRMB_REPORT_DOUBLE:
+			nrmb_report_csv_double(out, "%.17g", e[i].dval);
+			break;
+		case NRMB_REPORT_STRING:
+			nrmb_report_csv_string(out, e[i].sval);
+			break;
+		}
+		fputc('\n', out);
+	}
+}
+
+static void nrmb_report_csv(FILE *out, const struct nrmb_report *r, int header)
+{
+	if (header)
+		fprintf(out, "benchmark,section,name,key,value\n");
+	nrmb_report_csv_prefix(out, r, "info", "", "version");
+	fprintf(out, "%s\n", PACKAGE_VERSION);
+	nrmb_report_csv_entries(out, r, "config", r->config, r->num_config);
+	for (size_t i = 0; i < r->num_kernels; i++) {
+		const struct nrmb_report_kernel *k = &r->kernels[i];
+		const char *keys[] = {"avg", "min", "max", "p50", "p90", "p99",
+			"p99.9", "perf_avg", "perf_best"};
+		double values[] = {k->avg, k->min, k->max, k->p50, k->p90,
+			k->p99, k->p999, k->perf_avg, k->perf_best};
+		nrmb_report_csv_prefix(out, r, "kernel", k->name, "count");
+		fprintf(out, "%" PRIu64 "\n", k->count);
+		for (size_t j = 0; j < sizeof(keys)/sizeof(keys[0]); j++) {
+			nrmb_report_csv_prefix(out, r, "kernel", k->name,
+					       keys[j]);
+			nrmb_report_csv_double(out, "%.9g", values[j]);
+			fputc('\n', out);
+		}
+	}
+	nrmb_report_csv_entries(out, r, "metric", r->metrics, r->num_metrics);
+	nrmb_report_csv_prefix(out, r, "validation", "", "status");
+	fprintf(out, "%s\n", r->validation);
+}
+
+static void nrmb_report_free_entries(struct nrmb_report_entry *e, size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		free(e[i].name);
+		if (e[i].type == NRMB_REPORT_STRING)
+			free(e[i].sval);
+	}
+}
+
+int nrmb_report_finalize(struct nrmb_report *r)
+{
+	const char *format = getenv("NRMB_REPORT");
+	const char *path = getenv("NRMB_REPORT_FILE");
+	FILE *out = stdout;
+	int err = 0, header = 1;
+
+	if (format != NULL && *format != '\0') {
+		if (path != NULL && *path != '\0') {
+			out = fopen(path, "a");
+			if (out == NULL) {
+				fprintf(stderr, "nrmb: cannot open report file %s: %s\n",
+					path, strerror(errno));
+				err = -1;
+			}
+			/* only one CSV header per file */
+			else if (fseek(out, 0, SEEK_END) == 0 && ftell(out) > 0)
+				header = 0;
+		}
+		if (out != NULL) {
+			if (!strcmp(format, "json"))
+				nrmb_report_json(out, r);
+			else if (!strcmp(format, "csv"))
+				nrmb_report_csv(out, r, header);
+			else {
+				fprintf(stderr, "nrmb: unknown report format: %s\n",
+					format);
+				err = -1;
+			}
+			if (out != stdout)
+				fclose(out);
+		}
+	}
+
+	nrmb_report_free_entries(r->config, r->num_config);
+	nrmb_report_free_entries(r->metrics, r->num_metrics);
+	for (size_t i = 0; i < r->num_kernels; i++)
+		free(r->kernels[i].name);
+	free(r->benchmark);
+	free(r->description);
+	free(r);
+	return err;
+}
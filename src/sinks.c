@@ -0,0 +1,261 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#include "config.h"
+
+#include "nrm-benchmarks.h"
+#include "sinks.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*******************************************************************************
+ * libnrm: send events to the upstream nrmd
+ ******************************************************************************/
+
+static nrm_client_t *nrmb_client;
+static nrm_sensor_t *nrmb_sensor;
+static nrm_scope_t *nrmb_scope;
+
+static int nrmb_sink_nrm_init(const char *progname, const char *arg)
+{
+	(void)arg;
+	nrm_init(NULL, NULL);
+	nrm_log_init(stderr, progname);
+	nrm_client_create(&nrmb_client, nrm_upstream_uri, nrm_upstream_pub_port,
+			  nrm_upstream_rpc_port);
+	assert(nrmb_client != NULL);
+	nrm_string_t progress_name = nrm_string_fromprintf("nrm.benchmarks.progress");
+	nrmb_sensor = nrm_sensor_create(progress_name);
+	assert(nrmb_sensor != NULL);
+	nrm_client_add_sensor(nrmb_client, nrmb_sensor);
+
+	nrm_vector_t *nrmd_scopes;
+	size_t numscopes = 0;
+	nrm_client_list_scopes(nrmb_client, &nrmd_scopes);
+	nrm_vector_length(nrmd_scopes, &numscopes);
+	for (size_t i = 0; i < numscopes; i++) {
+		nrm_scope_t *s;
+		nrm_vector_pop_back(nrmd_scopes, &s);
+		if (!nrm_string_cmp(nrm_scope_uuid(s), "nrm.hwloc.Machine.0")) {
+			nrmb_scope = s;
+			continue;
+		}
+		nrm_scope_destroy(s);
+	}
+	assert(nrmb_scope != NULL);
+	nrm_vector_destroy(&nrmd_scopes);
+	return 0;
+}
+
+static int nrmb_sink_nrm_send(const nrm_time_t *time, double value)
+{
+	return nrm_client_send_event(nrmb_client, *time, nrmb_sensor, nrmb_scope,
+				     value);
+}
+
+static int nrmb_sink_nrm_fini(void)
+{
+	nrm_client_remove_sensor(nrmb_client, nrmb_sensor);
+	nrm_sensor_destroy(&nrmb_sensor);
+	nrm_scope_destroy(nrmb_scope);
+	nrm_client_destroy(&nrmb_client);
+	return 0;
+}
+
+struct nrmb_sink nrmb_sink_nrm = {
+	"nrm", nrmb_sink_nrm_init, nrmb_sink_nrm_send, nrmb_sink_nrm_fini,
+};
+
+/*******************************************************************************
+ * file: append binary records to a file, no daemon needed
+ ******************************************************************************/
+
+static FILE *sink_file;
+static nrm_time_t sink_start;
+
+static int nrmb_sink_file_init(const char *progname, const char *arg)
+{
+	struct stat st;
+	(void)progname;
+	assert(arg != NULL);
+	sink_file = fopen(arg, "ab");
+	if (sink_file == NULL) {
+		fprintf(stderr, "nrmb: cannot open progress file %s: %s\n", arg,
+			strerror(errno));
+		return -1;
+	}
+	/* only write a header at the beginning of the file, so that several
+	 * runs can append to the same one.
+	 */
+	if (fstat(fileno(sink_file), &st) == 0 && st.st_size == 0) {
+		struct nrmb_sink_header h = {
+			NRMB_SINK_MAGIC, NRMB_SINK_VERSION,
+			sizeof(struct nrmb_sink_record), 0, 0,
+		};
+		fwrite(&h, sizeof(h), 1, sink_file);
+	}
+	nrm_time_gettime(&sink_start);
+	return 0;
+}
+
+static int nrmb_sink_file_send(const nrm_time_t *time, double value)
+{
+	struct nrmb_sink_record r = { nrm_time_diff(&sink_start, time), value };
+	return fwrite(&r, sizeof(r), 1, sink_file) == 1 ? 0 : -1;
+}
+
+static int nrmb_sink_file_fini(void)
+{
+	int err = fclose(sink_file);
+	sink_file = NULL;
+	return err;
+}
+
+struct nrmb_sink nrmb_sink_file = {
+	"file", nrmb_sink_file_init, nrmb_sink_file_send, nrmb_sink_file_fini,
+};
+
+/*******************************************************************************
+ * mmap: fixed-size ring of records in a shared file mapping
+ ******************************************************************************/
+
+#define NRMB_SINK_MMAP_CAPACITY 65536
+
+static struct nrmb_sink_header *sink_ring;
+static size_t sink_ring_size;
+
+const char *nrmb_sink_mmap_path_end(const char *arg)
+{
+	const char *sep = strrchr(arg, ':');
+	if (sep == NULL || sep[1] == '\0' ||
+	    strspn(sep + 1, "0123456789") != strlen(sep + 1))
+		return arg + strlen(arg);
+	return sep;
+}
+
+static int nrmb_sink_mmap_init(const char *progname, const char *arg)
+{
+	char path[4096];
+	uint64_t capacity = NRMB_SINK_MMAP_CAPACITY;
+	const char *sep;
+	int fd;
+	(void)progname;
+
+	/* argument is path[:capacity] */
+	assert(arg != NULL);
+	sep = nrmb_sink_mmap_path_end(arg);
+	if (*sep == ':') {
+		errno = 0;
+		capacity = strtoull(sep + 1, NULL, 10);
+		assert(!errno && capacity > 0);
+	}
+	assert((size_t)(sep - arg) < sizeof(path));
+	memcpy(path, arg, sep - arg);
+	path[sep - arg] = '\0';
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "nrmb: cannot open progress ring %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+	sink_ring_size = sizeof(struct nrmb_sink_header) +
+		capacity * sizeof(struct nrmb_sink_record);
+	if (ftruncate(fd, sink_ring_size) == -1) {
+		close(fd);
+		return -1;
+	}
+	sink_ring = mmap(NULL, sink_ring_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, 0);
+	close(fd);
+	if (sink_ring == MAP_FAILED) {
+		sink_ring = NULL;
+		return -1;
+	}
+	memcpy(sink_ring->magic, NRMB_SINK_MAGIC, sizeof(sink_ring->magic));
+	sink_ring->version = NRMB_SINK_VERSION;
+	sink_ring->record_size = sizeof(struct nrmb_sink_record);
+	sink_ring->capacity = capacity;
+	__atomic_store_n(&sink_ring->head, 0, __ATOMIC_RELEASE);
+	nrm_time_gettime(&sink_start);
+	return 0;
+}
+
+static int nrmb_sink_mmap_send(const nrm_time_t *time, double value)
+{
+	struct nrmb_sink_record *records =
+		(struct nrmb_sink_record *)(sink_ring + 1);
+	uint64_t head = sink_ring->head;
+	struct nrmb_sink_record *r = &records[head % sink_ring->capacity];
+
+	r->time = nrm_time_diff(&sink_start, time);
+	r->value = value;
+	__atomic_store_n(&sink_ring->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int nrmb_sink_mmap_fini(void)
+{
+	int err = munmap(sink_ring, sink_ring_size);
+	sink_ring = NULL;
+	return err;
+}
+
+struct nrmb_sink nrmb_sink_mmap = {
+	"mmap", nrmb_sink_mmap_init, nrmb_sink_mmap_send, nrmb_sink_mmap_fini,
+};
+
+/*******************************************************************************
+ * none: drop everything, only useful to measure the reporting path itself
+ ******************************************************************************/
+
+static int nrmb_sink_none_init(const char *progname, const char *arg)
+{
+	(void)progname;
+	(void)arg;
+	return 0;
+}
+
+static int nrmb_sink_none_send(const nrm_time_t *time, double value)
+{
+	(void)time;
+	(void)value;
+	return 0;
+}
+
+static int nrmb_sink_none_fini(void)
+{
+	return 0;
+}
+
+struct nrmb_sink nrmb_sink_none = {
+	"none", nrmb_sink_none_init, nrmb_sink_none_send, nrmb_sink_none_fini,
+};
+
+static struct nrmb_sink *nrmb_sinks[] = {
+	&nrmb_sink_nrm, &nrmb_sink_file, &nrmb_sink_mmap, &nrmb_sink_none,
+};
+
+struct nrmb_sink *nrmb_sink_find(const char *spec, const char **arg)
+{
+	size_t len;
+	const char *sep = strchr(spec, ':');
+
+	len = sep ? (size_t)(sep - spec) : strlen(spec);
+	*arg = sep ? sep + 1 : NULL;
+	for (size_t i = 0; i < sizeof(nrmb_sinks)/sizeof(nrmb_sinks[0]); i++)
+		if (strlen(nrmb_sinks[i]->name) == len &&
+		    !strncmp(nrmb_sinks[i]->name, spec, len))
+			return nrmb_sinks[i];
+	return NULL;
+}
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Copyright 2021 UChicago Argonne, LLC.
+ * (c.f. AUTHORS, LICENSE)
+ *
+ * This file is part of the NRM Benchmarks project.
+ * For more info, see https://github.com/anlsys/nrm-benchmarks
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ ******************************************************************************/
+
+#ifndef NRMB_SINKS_H
+#define NRMB_SINKS_H 1
+
+#include <stdint.h>
+#include <nrm.h>
+
+/* A progress sink receives the rate-limited progress events of a benchmark.
+ * The sink is selected at runtime from the NRMB_PROGRESS_SINK environment
+ * variable, with the syntax "name[:argument]".
+ */
+struct nrmb_sink {
+	const char *name;
+	int (*init)(const char *progname, const char *arg);
+	int (*send)(const nrm_time_t *time, double value);
+	int (*fini)(void);
+};
+
+extern struct nrmb_sink nrmb_sink_nrm;
+extern struct nrmb_sink nrmb_sink_file;
+extern struct nrmb_sink nrmb_sink_mmap;
+extern struct nrmb_sink nrmb_sink_none;
+
+/* find the sink matching spec, and point arg to its argument (or NULL) */
+struct nrmb_sink *nrmb_sink_find(const char *spec, const char **arg);
+
+/* end of the path in the path[:capacity] argument of the mmap sink: the colon
+ * before the capacity, or the end of the string when there is none. Only a
+ * suffix of digits is a capacity, so that paths may contain colons.
+ */
+const char *nrmb_sink_mmap_path_end(const char *arg);
+
+/* on-disk format of the file and mmap sinks: a header followed by records.
+ * Record times are in nanoseconds since the sink initialization.
+ *
+ * The mmap sink is a ring of capacity records: the record with sequence
+ * number n lives at index n % capacity, and head is the number of records
+ * written so far, updated after the record itself.
+ */
+#define NRMB_SINK_MAGIC "NRMBPRGS"
+#define NRMB_SINK_VERSION 1
+
+struct nrmb_sink_record {
+	int64_t time;
+	double value;
+};
+
+struct nrmb_sink_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;
+	uint64_t head;
+};
+
+/* layout of the NRMB_PROGRESS_SHM file: this header, followed by num_slots
+ * cache lines, one per thread, each starting with the double progress count
+ * of that thread. The sum of these counts is the exact progress so far.
+ * The header holds the progress already merged by the benchmark (total) and
+ * the time of the last report of the master thread (time, in nanoseconds
+ * since initialization). Each field is updated with a single atomic store.
+ */
+#define NRMB_SHM_MAGIC "NRMBPSHM"
+#define NRMB_SHM_VERSION 1
+
+struct nrmb_shm_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_slots;
+	int64_t pid;
+	int64_t time;
+	double total;
+	char pad[24];
+};
+
+#endif
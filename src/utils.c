@@ -11,6 +11,13 @@
 #include "config.h"
 
 #include "nrm-benchmarks.h"
+#include "sinks.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
 
 int nrmb_check_double(double ref, double value, int bits)
 {
@@ -25,66 +32,470 @@ int nrmb_check_double_prec(double ref, double value, double eps)
 	return diff <= NRMB_MAX(NRMB_ABS(ref), NRMB_ABS(value)) * eps;
 }
 
-static nrm_client_t *nrmb_client;
-static nrm_sensor_t *nrmb_sensor;
-static nrm_scope_t *nrmb_scope;
+/* post validation of whole arrays: each thread checks its static share in
+ * blocks, and gives up on the rest as soon as any thread found a mismatch.
+ * The reduction gives the result, the shared flag only cuts the work short.
+ */
+#define NRMB_CHECK_BLOCK 4096
+
+static int nrmb_check_range(double ref, const double *refs,
+			    const double *values, size_t n, int bits)
+{
+	int err = 0, failed = 0;
+
+#pragma omp parallel reduction(||:err)
+	{
+		size_t start, end;
+		nrmb_static_range(n, &start, &end);
+		for (size_t k = start; k < end && !err; k += NRMB_CHECK_BLOCK) {
+			size_t stop = NRMB_MIN(k + NRMB_CHECK_BLOCK, end);
+			if (__atomic_load_n(&failed, __ATOMIC_RELAXED))
+				break;
+			for (size_t i = k; i < stop; i++)
+				err |= !nrmb_check_double(refs ? refs[i] : ref,
+							  values[i], bits);
+		}
+		if (err)
+			__atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+	}
+	return !err;
+}
+
+int nrmb_check_array(double ref, const double *values, size_t n, int bits)
+{
+	return nrmb_check_range(ref, NULL, values, n, bits);
+}
+
+int nrmb_check_arrays(const double *refs, const double *values, size_t n,
+		      int bits)
+{
+	return nrmb_check_range(0.0, refs, values, n, bits);
+}
+
+static struct nrmb_sink *nrmb_sink;
 static nrm_time_t last_progress;
-static double global_count = 0.0;
+static int64_t progress_ratelimit;
 
-int nrmb_init(const char *progname)
+/* progress accumulation: each OpenMP thread owns a counter padded to its own
+ * cache line, and only ever writes to it. The master thread merges the
+ * counters before each rate-limited send, remembering how much of each one it
+ * already consumed. This way, progress can be reported from inside a parallel
+ * region without locks or false sharing.
+ */
+#define NRMB_CACHE_LINE 64
+
+struct nrmb_progress_slot {
+	double count;
+	char pad[NRMB_CACHE_LINE - sizeof(double)];
+};
+
+static struct nrmb_progress_slot *progress_slots;
+static double *progress_consumed;
+static int num_progress_slots;
+static int progress_first_slot;
+
+/* shared-memory view of the progress: when NRMB_PROGRESS_SHM names a file, the
+ * counters above live in a shared mapping of it, right after a small header
+ * that the master thread keeps up to date with atomic stores. External tools
+ * can then sample progress at any rate without any syscall on our side.
+ */
+static struct nrmb_shm_header *progress_shm;
+static size_t progress_shm_size;
+static nrm_time_t progress_start;
+static double progress_total;
+
+static struct nrmb_progress_slot *nrmb_progress_shm_init(const char *path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "nrmb: cannot open progress file %s: %s\n", path,
+			strerror(errno));
+		return NULL;
+	}
+	progress_shm_size = sizeof(struct nrmb_shm_header) +
+		num_progress_slots * sizeof(struct nrmb_progress_slot);
+	if (ftruncate(fd, progress_shm_size) == -1) {
+		close(fd);
+		return NULL;
+	}
+	progress_shm = mmap(NULL, progress_shm_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+	close(fd);
+	if (progress_shm == MAP_FAILED) {
+		progress_shm = NULL;
+		return NULL;
+	}
+	memcpy(progress_shm->magic, NRMB_SHM_MAGIC, sizeof(progress_shm->magic));
+	progress_shm->version = NRMB_SHM_VERSION;
+	progress_shm->num_slots = num_progress_slots;
+	progress_shm->pid = getpid();
+	return (struct nrmb_progress_slot *)(progress_shm + 1);
+}
+
+static void nrmb_progress_shm_time(const nrm_time_t *now)
 {
+	if (progress_shm != NULL)
+		__atomic_store_n(&progress_shm->time,
+				 nrm_time_diff(&progress_start, now),
+				 __ATOMIC_RELEASE);
+}
 
-	nrm_init(NULL, NULL);
-	nrm_log_init(stderr, progname);
-	nrm_client_create(&nrmb_client, nrm_upstream_uri, nrm_upstream_pub_port,
-			  nrm_upstream_rpc_port);
-	assert(nrmb_client != NULL);
-	nrm_string_t progress_name = nrm_string_fromprintf("nrm.benchmarks.progress");
-	nrmb_sensor = nrm_sensor_create(progress_name);
-	assert(nrmb_sensor != NULL);
-	nrm_client_add_sensor(nrmb_client, nrmb_sensor);
-
-	nrm_vector_t *nrmd_scopes;
-	size_t numscopes = 0;
-	nrm_client_list_scopes(nrmb_client, &nrmd_scopes);
-	nrm_vector_length(nrmd_scopes, &numscopes);
-	for (size_t i = 0; i < numscopes; i++) {
-		nrm_scope_t *s;
-		nrm_vector_pop_back(nrmd_scopes, &s);
-		if (!nrm_string_cmp(nrm_scope_uuid(s), "nrm.hwloc.Machine.0")) {
-			nrmb_scope = s;
-			continue;
+static void nrmb_progress_shm_total(double merged)
+{
+	progress_total += merged;
+	if (progress_shm != NULL)
+		__atomic_store(&progress_shm->total, &progress_total,
+			       __ATOMIC_RELEASE);
+}
+
+static void nrmb_progress_slots_init(void)
+{
+	const char *path = getenv("NRMB_PROGRESS_SHM");
+	num_progress_slots = NRMB_MAX(omp_get_max_threads(), omp_get_num_procs());
+	if (path != NULL && *path != '\0') {
+		progress_slots = nrmb_progress_shm_init(path);
+		assert(progress_slots != NULL);
+	} else {
+		int err = posix_memalign((void **)&progress_slots,
+					 NRMB_CACHE_LINE,
+					 num_progress_slots *
+					 sizeof(struct nrmb_progress_slot));
+		assert(!err);
+	}
+	progress_consumed = calloc(num_progress_slots, sizeof(double));
+	assert(progress_consumed != NULL);
+	for (int i = 0; i < num_progress_slots; i++)
+		progress_slots[i].count = 0.0;
+	progress_first_slot = 0;
+	progress_total = 0.0;
+	nrm_time_gettime(&progress_start);
+}
+
+static void nrmb_progress_slots_fini(void)
+{
+	/* the shared file stays around, for post-mortem checks */
+	if (progress_shm != NULL)
+		munmap(progress_shm, progress_shm_size);
+	else
+		free(progress_slots);
+	free(progress_consumed);
+	progress_shm = NULL;
+	progress_slots = NULL;
+	progress_consumed = NULL;
+	num_progress_slots = 0;
+}
+
+/* collect everything the threads reported since the last merge. Only one
+ * thread can call this: the master thread, or the publisher when enabled.
+ * The publisher gets the master progress from the ring instead of its slot.
+ */
+static double nrmb_progress_merge(void)
+{
+	double total = 0.0;
+	for (int i = progress_first_slot; i < num_progress_slots; i++) {
+		double count;
+#pragma omp atomic read
+		count = progress_slots[i].count;
+		total += count - progress_consumed[i];
+		progress_consumed[i] = count;
+	}
+	nrmb_progress_shm_total(total);
+	return total;
+}
+
+/* publisher mode: the benchmark master thread only pushes (timestamp, value)
+ * records into a single-producer, single-consumer ring buffer. A dedicated
+ * thread drains it, merges the worker counters and takes care of the
+ * rate-limited sends, so that NRM client latency stays out of the timed loops.
+ * If the ring is full, the master keeps accumulating locally and retries on
+ * its next report, so no progress is ever lost.
+ */
+#define NRMB_RING_SIZE 4096
+#define NRMB_PUBLISHER_PERIOD 1000000
+
+struct nrmb_progress_record {
+	nrm_time_t time;
+	double value;
+};
+
+static struct {
+	struct nrmb_progress_record records[NRMB_RING_SIZE];
+	size_t head __attribute__((aligned(NRMB_CACHE_LINE)));
+	size_t tail __attribute__((aligned(NRMB_CACHE_LINE)));
+} progress_ring;
+
+static int publisher_enabled;
+static int publisher_running;
+static pthread_t publisher_thread;
+static double publisher_pending;
+static double publisher_leftover;
+
+static int nrmb_publisher_push(const nrm_time_t *now, double value)
+{
+	size_t head = progress_ring.head;
+	size_t tail = __atomic_load_n(&progress_ring.tail, __ATOMIC_ACQUIRE);
+
+	publisher_pending += value;
+	if (head - tail == NRMB_RING_SIZE)
+		return 0;
+	struct nrmb_progress_record *r =
+		&progress_ring.records[head % NRMB_RING_SIZE];
+	r->time = *now;
+	r->value = publisher_pending;
+	publisher_pending = 0.0;
+	__atomic_store_n(&progress_ring.head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* drain the ring, returns the accumulated value and the time of the latest
+ * record in last, if any.
+ */
+static double nrmb_publisher_drain(nrm_time_t *last)
+{
+	double total = 0.0;
+	size_t tail = progress_ring.tail;
+	size_t head = __atomic_load_n(&progress_ring.head, __ATOMIC_ACQUIRE);
+
+	for (; tail != head; tail++) {
+		struct nrmb_progress_record *r =
+			&progress_ring.records[tail % NRMB_RING_SIZE];
+		total += r->value;
+		*last = r->time;
+	}
+	__atomic_store_n(&progress_ring.tail, tail, __ATOMIC_RELEASE);
+	return total;
+}
+
+static void *nrmb_publisher_main(void *arg)
+{
+	double count = 0.0;
+	struct timespec period = { 0, NRMB_PUBLISHER_PERIOD };
+	(void)arg;
+
+	while (__atomic_load_n(&publisher_running, __ATOMIC_ACQUIRE)) {
+		nrm_time_t now;
+		nrm_time_gettime(&now);
+		double drained = nrmb_publisher_drain(&now);
+		nrmb_progress_shm_total(drained);
+		count += drained + nrmb_progress_merge();
+		int64_t diff = nrm_time_diff(&last_progress, &now);
+		int64_t ratelimit = __atomic_load_n(&progress_ratelimit,
+						    __ATOMIC_RELAXED);
+		if (count != 0.0 && diff > ratelimit) {
+			nrmb_sink->send(&now, count);
+			count = 0.0;
+			last_progress = now;
 		}
-		nrm_scope_destroy(s);
+		nanosleep(&period, NULL);
 	}
-	assert(nrmb_scope != NULL);
-	nrm_vector_destroy(&nrmd_scopes);
+	/* leftovers are picked up by nrmb_finalize */
+	publisher_leftover = count;
+	return NULL;
+}
+
+static void nrmb_publisher_start(void)
+{
+	const char *env = getenv("NRMB_PROGRESS_THREAD");
+	publisher_enabled = env != NULL && *env != '\0' && strcmp(env, "0");
+	if (!publisher_enabled)
+		return;
+	progress_first_slot = 1;
+	progress_ring.head = 0;
+	progress_ring.tail = 0;
+	publisher_pending = 0.0;
+	publisher_leftover = 0.0;
+	publisher_running = 1;
+	int err = pthread_create(&publisher_thread, NULL, nrmb_publisher_main,
+				 NULL);
+	assert(!err);
+}
+
+/* stop the publisher and return everything it did not send yet */
+static double nrmb_publisher_stop(void)
+{
+	nrm_time_t last;
+	if (!publisher_enabled)
+		return 0.0;
+	__atomic_store_n(&publisher_running, 0, __ATOMIC_RELEASE);
+	pthread_join(publisher_thread, NULL);
+	publisher_enabled = 0;
+	double count = publisher_pending + nrmb_publisher_drain(&last);
+	nrmb_progress_shm_total(count);
+	return count + publisher_leftover;
+}
+
+int nrmb_init(const char *progname)
+{
+	const char *spec = getenv("NRMB_PROGRESS_SINK");
+	const char *arg = NULL;
+	int err;
+
+	if (spec == NULL || *spec == '\0')
+		spec = "nrm";
+	nrmb_sink = nrmb_sink_find(spec, &arg);
+	if (nrmb_sink == NULL) {
+		fprintf(stderr, "nrmb: unknown progress sink: %s\n", spec);
+		assert(0);
+	}
+	err = nrmb_sink->init(progname, arg);
+	assert(!err);
+
+	nrmb_progress_slots_init();
+	progress_ratelimit = (int64_t)nrm_ratelimit;
 	nrm_time_gettime(&last_progress);
+	nrmb_publisher_start();
 	return 0;
 }
 
 int nrmb_finalize(void)
 {
 	nrm_time_t now;
+	double count = nrmb_publisher_stop();
 	nrm_time_gettime(&now);
-	nrm_client_send_event(nrmb_client, now, nrmb_sensor, nrmb_scope, global_count);
-	nrm_client_remove_sensor(nrmb_client, nrmb_sensor);
-	nrm_sensor_destroy(&nrmb_sensor);
-	nrm_scope_destroy(nrmb_scope);
-	nrm_client_destroy(&nrmb_client);
+	count += nrmb_progress_merge();
+	nrmb_sink->send(&now, count);
+	nrmb_sink->fini();
+	nrmb_progress_slots_fini();
 	return 0;
 }
 
 int nrmb_send_progress(double value)
 {
+	/* nested parallel regions would have several threads share a slot */
+	assert(omp_get_active_level() <= 1);
+	int tid = omp_get_thread_num();
+	assert(tid < num_progress_slots);
+
+	/* only the owner ever writes to its slot, so the atomic is uncontended:
+	 * it only ensures that readers never see a torn value.
+	 */
+#pragma omp atomic update
+	progress_slots[tid].count += value;
+
+	if (tid != 0)
+		return 0;
+
 	nrm_time_t now;
 	nrm_time_gettime(&now);
+	nrmb_progress_shm_time(&now);
+	if (publisher_enabled)
+		return nrmb_publisher_push(&now, value);
+
 	int64_t diff = nrm_time_diff(&last_progress, &now);
-	global_count += value;
-	if (diff > (int64_t)nrm_ratelimit) {
-		nrm_client_send_event(nrmb_client, now, nrmb_sensor, nrmb_scope, global_count);
-		global_count = 0.0;
+	if (diff > progress_ratelimit) {
+		nrmb_sink->send(&now, nrmb_progress_merge());
 		last_progress = now;
 	}
 	return 0;
 }
+
+int64_t nrmb_set_ratelimit(int64_t ns)
+{
+	int64_t old = progress_ratelimit;
+	__atomic_store_n(&progress_ratelimit, ns, __ATOMIC_RELAXED);
+	return old;
+}
+
+void nrmb_static_range(size_t n, size_t *start, size_t *end)
+{
+	size_t tid = omp_get_thread_num();
+	size_t nthreads = omp_get_num_threads();
+	size_t chunk = n / nthreads;
+	size_t rem = n % nthreads;
+
+	/* same split as libgomp for schedule(static): the first rem threads
+	 * get one more iteration.
+	 */
+	if (tid < rem) {
+		*start = tid * (chunk + 1);
+		*end = *start + chunk + 1;
+	} else {
+		*start = rem * (chunk + 1) + (tid - rem) * chunk;
+		*end = *start + chunk;
+	}
+}
+
+uint64_t nrmb_rand(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* duration-based runs: the iteration count given to a benchmark can be a
+ * wall-clock duration instead, each timed loop then runs until that much time
+ * elapsed since its first iteration. The deadline is only checked between
+ * iterations, so that a kernel always runs to completion.
+ */
+static int64_t run_duration;
+static nrm_time_t run_start;
+
+int64_t nrmb_parse_duration(const char *arg)
+{
+	const struct {
+		const char *unit;
+		double ns;
+	} units[] = {{"ms", 1.0E06}, {"s", 1.0E09}, {"m", 60.0E09},
+		     {"h", 3600.0E09}};
+	double value;
+	char *end;
+
+	errno = 0;
+	(void)strtol(arg, &end, 0);
+	if (end != arg && *end == '\0')
+		return 0;
+
+	errno = 0;
+	value = strtod(arg, &end);
+	assert(!errno && end != arg && value > 0.0);
+	for (size_t i = 0; i < sizeof(units)/sizeof(units[0]); i++) {
+		if (strcmp(end, units[i].unit))
+			continue;
+		return (int64_t)(value * units[i].ns);
+	}
+	fprintf(stderr, "nrmb: unknown duration unit: %s\n", arg);
+	assert(0);
+	return 0;
+}
+
+long int nrmb_parse_times(const char *arg)
+{
+	long int times;
+
+	run_duration = nrmb_parse_duration(arg);
+	if (run_duration > 0)
+		return LONG_MAX;
+
+	errno = 0;
+	times = strtol(arg, NULL, 0);
+	assert(!errno && times >= 0);
+	return times;
+}
+
+int64_t nrmb_run_duration(void)
+{
+	return run_duration;
+}
+
+int nrmb_run_expired(long int iter)
+{
+	nrm_time_t now;
+
+	if (run_duration == 0)
+		return 0;
+	nrm_time_gettime(&now);
+	if (iter == 0) {
+		run_start = now;
+		return 0;
+	}
+	return nrm_time_diff(&run_start, &now) >= run_duration;
+}
+
+int nrmb_run_next(long int iter, long int *times)
+{
+	if (iter < *times && !nrmb_run_expired(iter))
+		return 1;
+	*times = iter;
+	return 0;
+}